@@ -0,0 +1,23 @@
+/*
+* \brief The distance kept between members written by different threads
+*
+* The members written by different threads are kept at least this far apart, so that writing some doesn't evict the others from the caches of
+* other cores, and from the members of neighbouring instances. It can be defined before including any of the headers, for example to 128 on CPUs
+* with larger cache lines or to 1 to pack the members together for comparison.
+*/
+
+#ifndef LOOPING_CACHE_LINE_H
+#define LOOPING_CACHE_LINE_H
+
+#include <new>
+
+#ifndef LOOPING_THREAD_CACHE_LINE
+// GCC warns about the value depending on tuning flags, so it's not used where it would change the layout between translation units
+#if defined(__cpp_lib_hardware_interference_size) && (!defined(__GNUC__) || defined(__clang__))
+#define LOOPING_THREAD_CACHE_LINE std::hardware_destructive_interference_size
+#else
+#define LOOPING_THREAD_CACHE_LINE 64
+#endif
+#endif
+
+#endif // LOOPING_CACHE_LINE_H
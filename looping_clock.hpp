@@ -0,0 +1,60 @@
+/*
+* \brief Class for a clock that only moves when told to, for running looping routines in simulated time
+*
+* A LoopingScheduler constructed with a manual clock has no threads, its run methods call the due routines on the calling thread and advance the clock
+* straight to the next deadline instead of waiting for it, so hours of periodic activity take as long as the routines themselves.
+*
+* \note The time points are std::chrono::steady_clock time points, so that the routines and statistics don't depend on which clock is used
+*/
+
+#ifndef LOOPING_CLOCK_H
+#define LOOPING_CLOCK_H
+
+#include <chrono>
+#include <atomic>
+
+class LoopingManualClock {
+	std::atomic<std::chrono::steady_clock::rep> now_;
+
+public:
+	/*!
+	* \brief Constructs the clock
+	* \param The time it shows until it's advanced
+	*/
+	inline explicit LoopingManualClock(std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now()) : now_(start.time_since_epoch().count())
+	{
+
+	}
+
+	LoopingManualClock(const LoopingManualClock&) = delete;
+	LoopingManualClock& operator=(const LoopingManualClock&) = delete;
+
+	/*!
+	* \brief Returns the time it shows, can be called from any thread
+	*/
+	inline std::chrono::steady_clock::time_point now() const
+	{
+		return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(now_.load(std::memory_order_acquire)));
+	}
+
+	/*!
+	* \brief Moves the clock forward to a given time, does nothing if it's already later
+	* \param The time
+	*/
+	inline void advanceTo(std::chrono::steady_clock::time_point time)
+	{
+		std::chrono::steady_clock::rep target = time.time_since_epoch().count();
+		std::chrono::steady_clock::rep current = now_.load(std::memory_order_relaxed);
+		while (current < target && !now_.compare_exchange_weak(current, target, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+
+	/*!
+	* \brief Moves the clock forward
+	* \param By how much
+	*/
+	inline void advance(std::chrono::steady_clock::duration duration)
+	{
+		advanceTo(now() + duration);
+	}
+};
+#endif // LOOPING_CLOCK_H
@@ -0,0 +1,271 @@
+/*
+* \brief Class for running a coroutine that periodically waits for the next tick, using the threads of a LoopingScheduler
+*
+* Instead of calling a routine from the beginning every period, the coroutine runs until it awaits nextTick() or sleepUntil() and is resumed
+* by one of the scheduler's threads at that time, so it can keep its state in local variables.
+*
+* \note Requires C++20
+*/
+
+#ifndef LOOPING_COROUTINE_H
+#define LOOPING_COROUTINE_H
+
+// MSVC keeps __cplusplus at 199711L unless compiled with /Zc:__cplusplus, _MSVC_LANG has the standard it compiles
+#if !defined(__cpp_impl_coroutine) || (__cplusplus < 202002L && (!defined(_MSVC_LANG) || _MSVC_LANG < 202002L))
+#error "LoopingCoroutine requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+#include <chrono>
+#include <iostream>
+#include "looping_scheduler.hpp"
+#include "looping_stats.hpp"
+
+class LoopingCoroutine {
+public:
+	/*!
+	* \brief The return type of the coroutine
+	*/
+	class Task {
+	public:
+		struct promise_type {
+			std::exception_ptr error;
+
+			inline Task get_return_object()
+			{
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			inline std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			inline std::suspend_always final_suspend() noexcept
+			{
+				return {};
+			}
+
+			inline void return_void()
+			{
+
+			}
+
+			inline void unhandled_exception()
+			{
+				error = std::current_exception();
+			}
+		};
+
+	private:
+		friend class LoopingCoroutine;
+		std::coroutine_handle<promise_type> handle_;
+
+		inline explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle)
+		{
+
+		}
+
+	public:
+		inline Task(Task&& other) noexcept : handle_(other.handle_)
+		{
+			other.handle_ = nullptr;
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		inline ~Task()
+		{
+			if (handle_)
+				handle_.destroy();
+		}
+	};
+
+	/*!
+	* \brief What the coroutine awaits to be resumed at a given time
+	*/
+	class Awaiter {
+		LoopingCoroutine* owner_;
+		std::chrono::steady_clock::time_point at_;
+		bool ready_;
+
+	public:
+		inline Awaiter(LoopingCoroutine* owner, std::chrono::steady_clock::time_point at, bool ready) : owner_(owner), at_(at), ready_(ready)
+		{
+
+		}
+
+		inline bool await_ready() const noexcept
+		{
+			return ready_;
+		}
+
+		inline void await_suspend(std::coroutine_handle<>) noexcept
+		{
+			owner_->resumeAt_ = at_;
+		}
+
+		inline void await_resume() const noexcept
+		{
+
+		}
+	};
+
+private:
+	std::chrono::steady_clock::duration period_;
+	std::function<Task(LoopingCoroutine&)> body_;
+	std::function<void(const std::exception&)> errorCallback_;
+	bool paused_ = true;
+	bool resetTimeOnPause_ = true;
+	bool catchUp_ = true;
+	std::chrono::steady_clock::time_point awakenAt_;
+	std::chrono::steady_clock::time_point resumeAt_;
+	LoopingStatsRecorder stats_;
+	Task coroutine_;
+	LoopingScheduler* scheduler_;
+	LoopingScheduler::Task task_;
+
+	inline bool fire(std::chrono::steady_clock::time_point& at)
+	{
+		if (coroutine_.handle_.done())
+			return false;
+		std::chrono::steady_clock::time_point started = scheduler_->now();
+		coroutine_.handle_.resume();
+		stats_.record(at, started, scheduler_->now(), period_);
+		if (coroutine_.handle_.done()) {
+			if (coroutine_.handle_.promise().error) {
+				try {
+					std::rethrow_exception(coroutine_.handle_.promise().error);
+				} catch(std::exception& e) {
+					errorCallback_(e);
+				} catch(...) {
+					errorCallback_(std::runtime_error("An unknown error has been thrown in a looping coroutine"));
+				}
+			}
+			return false;
+		}
+		at = resumeAt_;
+		return true;
+	}
+
+public:
+	/*!
+	* \brief Creates the coroutine and starts running it
+	* \param The scheduler whose threads resume the coroutine, must outlive this object
+	* \param The period of nextTick()
+	* \param The function creating the coroutine, it's kept for the lifetime of this object, so the coroutine can use its captures
+	* \param If it starts running or is paused until resume() is called
+	*/
+	inline LoopingCoroutine(LoopingScheduler& scheduler, std::chrono::steady_clock::duration period, std::function<Task(LoopingCoroutine&)> body, bool run = true) :
+		period_(period),
+		body_(body),
+		errorCallback_([](const std::exception& e) { std::cout << e.what() << std::endl; }),
+		coroutine_(body_(*this)),
+		scheduler_(&scheduler),
+		task_([this] (std::chrono::steady_clock::time_point& at) { return fire(at); })
+	{
+		if (run)
+			resume();
+	}
+
+	LoopingCoroutine(const LoopingCoroutine&) = delete;
+	LoopingCoroutine& operator=(const LoopingCoroutine&) = delete;
+
+	/*!
+	* \brief The destructor, waits for the coroutine to suspend if it's running and destroys it
+	*/
+	inline ~LoopingCoroutine()
+	{
+		scheduler_->cancel(task_);
+	}
+
+	/*!
+	* \brief Returns an awaitable that resumes the coroutine at the next tick of the period
+	*/
+	inline Awaiter nextTick()
+	{
+		if (catchUp_)
+			awakenAt_ += period_;
+		else
+			awakenAt_ = scheduler_->now() + period_;
+		return Awaiter(this, awakenAt_, false);
+	}
+
+	/*!
+	* \brief Returns an awaitable that resumes the coroutine at a given time, doesn't affect the times of the ticks
+	* \param The time
+	*/
+	inline Awaiter sleepUntil(std::chrono::steady_clock::time_point at)
+	{
+		return Awaiter(this, at, at <= scheduler_->now());
+	}
+
+	/*!
+	* \brief Pause the execution, will wait until the coroutine suspends if it's running
+	* \param If the ticks should start over from the time of resumption, otherwise the coroutine is resumed at the time it awaited
+	*/
+	inline void pause(bool resetTime = true)
+	{
+		if (paused_) throw std::logic_error("Pausing a looping coroutine that is already paused");
+		paused_ = true;
+		scheduler_->cancel(task_);
+		resetTimeOnPause_ = resetTime;
+	}
+
+	/*!
+	* \brief Resume paused execution, does nothing else if the coroutine has already ended
+	*/
+	inline void resume()
+	{
+		if (!paused_) throw std::logic_error("Resuming a looping coroutine that is not paused");
+		paused_ = false;
+		if (coroutine_.handle_.done())
+			return;
+		if (resetTimeOnPause_)
+			awakenAt_ = resumeAt_ = scheduler_->now();
+		resetTimeOnPause_ = false;
+		scheduler_->schedule(task_, resumeAt_);
+	}
+
+	/*!
+	* \brief Changes the period
+	* \param The new period of nextTick()
+	*
+	* \note Must be called from the coroutine or while paused
+	*/
+	inline void setPeriod(std::chrono::steady_clock::duration newPeriod)
+	{
+		period_ = newPeriod;
+	}
+
+	/*!
+	* \brief Enables or disables the catch up feature of nextTick()
+	* \param If it should be enabled
+	*/
+	inline void setCatchUp(bool catchUp)
+	{
+		catchUp_ = catchUp;
+	}
+
+	/*!
+	* \brief Changes error callback
+	* \param errorCallback function which is called when exception is thrown in the coroutine, which ends it
+	*/
+	inline void setErrorCallback(std::function<void(const std::exception&)> errorCallback)
+	{
+		errorCallback_ = errorCallback;
+	}
+
+	/*!
+	* \brief Returns the statistics of the resumptions of the coroutine, can be called from any thread
+	*/
+	inline LoopingStats stats() const
+	{
+		return stats_.snapshot();
+	}
+};
+#endif // LOOPING_COROUTINE_H
@@ -0,0 +1,198 @@
+/*
+* \brief Classes for reporting the errors of looping routines without slowing down the threads calling them
+*
+* The thread calling the routine only puts the error into a lock-free queue, and a background thread of the reporter drains the queue and passes
+* the errors to a sink. Each loop limits how many errors it reports per interval and leaves out repetitions of the same error, the errors left out
+* are counted and the count is attached to the next reported error.
+*/
+
+#ifndef LOOPING_ERRORS_H
+#define LOOPING_ERRORS_H
+
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <utility>
+
+/*!
+* \brief An error thrown by a looping routine
+*/
+struct LoopingError {
+	const void* loop; //!< The object identifying the loop, the loop may not exist any more
+	std::string name; //!< The name the loop was registered with
+	uint64_t tick; //!< The number of calls that had ended before, the index of the call from zero if the routine threw it
+	std::chrono::steady_clock::time_point time; //!< When it was thrown, in the loop's clock
+	std::string what; //!< The message of the exception
+	uint64_t suppressed; //!< How many errors of the same loop were left out since the previous reported one
+};
+
+/*!
+* \brief Decides which errors of one loop are reported, used only by the thread calling the routine
+*/
+class LoopingErrorLimiter {
+	size_t burst_ = 10;
+	std::chrono::steady_clock::duration interval_ = std::chrono::seconds(1);
+	std::chrono::steady_clock::time_point windowStart_;
+	size_t reported_ = 0;
+	std::string last_;
+	uint64_t suppressed_ = 0;
+
+public:
+	/*!
+	* \brief Sets the limit
+	* \param At most this many errors are reported per interval
+	* \param The interval, an error with the same message as the previous reported one isn't reported again within it
+	*/
+	inline void setLimit(size_t burst, std::chrono::steady_clock::duration interval)
+	{
+		burst_ = burst;
+		interval_ = interval;
+	}
+
+	/*!
+	* \brief Returns if an error should be reported, otherwise counts it as suppressed
+	* \param The message of the error
+	* \param The current time
+	*/
+	inline bool admit(const char* what, std::chrono::steady_clock::time_point now)
+	{
+		if (reported_ == 0 || now - windowStart_ >= interval_) {
+			windowStart_ = now;
+			reported_ = 0;
+			last_.clear();
+		}
+		if (reported_ >= burst_ || last_ == what) {
+			suppressed_++;
+			return false;
+		}
+		reported_++;
+		last_ = what;
+		return true;
+	}
+
+	/*!
+	* \brief Returns the number of errors suppressed since the last call and starts counting from zero
+	*/
+	inline uint64_t takeSuppressed()
+	{
+		uint64_t suppressed = suppressed_;
+		suppressed_ = 0;
+		return suppressed;
+	}
+};
+
+/*!
+* \brief Receives errors from many loops and passes them to a sink from its own thread
+*
+* \note The loops reporting to it must be destroyed before it, the errors that are still queued are passed to the sink when it's destroyed
+*/
+class LoopingErrorReporter {
+	struct Node {
+		LoopingError error;
+		Node* next;
+	};
+
+	std::atomic<Node*> head_{nullptr};
+	std::function<void(const LoopingError&)> sink_;
+	std::chrono::steady_clock::duration interval_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	bool exiting_ = false;
+	std::thread thread_;
+
+	inline void drain()
+	{
+		Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+		// The queue is a stack, reversing it restores the order of reporting
+		Node* ordered = nullptr;
+		while (node) {
+			Node* next = node->next;
+			node->next = ordered;
+			ordered = node;
+			node = next;
+		}
+		while (ordered) {
+			Node* next = ordered->next;
+			try {
+				sink_(ordered->error);
+			} catch(...) {
+				// There is nowhere to report the errors of the error reporting
+			}
+			delete ordered;
+			ordered = next;
+		}
+	}
+
+	inline void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!exiting_) {
+			// Polling keeps reporting free of system calls, waking up this thread would need one
+			wakeup_.wait_for(lock, interval_, [this] { return exiting_; });
+			lock.unlock();
+			drain();
+			lock.lock();
+		}
+	}
+
+public:
+	/*!
+	* \brief Writes an error to std::cerr, the default sink
+	* \param The error
+	*/
+	static inline void print(const LoopingError& error)
+	{
+		std::cerr << (error.name.empty() ? "Looping thread" : error.name) << ", call " << error.tick << ": " << error.what;
+		if (error.suppressed)
+			std::cerr << " (" << error.suppressed << " more errors left out)";
+		std::cerr << std::endl;
+	}
+
+	/*!
+	* \brief Constructs the reporter and starts its thread
+	* \param The function the errors are passed to, called from the reporter's thread
+	* \param How often the queue is drained
+	*/
+	inline explicit LoopingErrorReporter(std::function<void(const LoopingError&)> sink = &LoopingErrorReporter::print,
+			std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100)) :
+		sink_(sink),
+		interval_(interval),
+		thread_(&LoopingErrorReporter::work, this)
+	{
+
+	}
+
+	LoopingErrorReporter(const LoopingErrorReporter&) = delete;
+	LoopingErrorReporter& operator=(const LoopingErrorReporter&) = delete;
+
+	/*!
+	* \brief The destructor, passes the queued errors to the sink and stops the thread
+	*/
+	inline ~LoopingErrorReporter()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			exiting_ = true;
+		}
+		wakeup_.notify_one();
+		thread_.join();
+		drain();
+	}
+
+	/*!
+	* \brief Queues an error, can be called from any thread without blocking
+	* \param The error
+	*/
+	inline void report(LoopingError error)
+	{
+		Node* node = new Node{std::move(error), head_.load(std::memory_order_relaxed)};
+		while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+};
+#endif // LOOPING_ERRORS_H
@@ -0,0 +1,247 @@
+/*
+* \brief Class for calling a routine periodically for a number of shards in parallel
+*
+* Every period, the routine is called once for each shard index. The calls are distributed between a pool of threads, including the looping thread
+* itself, and the next period is scheduled when all of them end. Periods in which the calls took longer than the period are counted as overruns.
+*
+* \note Exceptions thrown by the calls are passed to the error callback, only the first one from each period
+*/
+
+#ifndef LOOPING_FAN_OUT_H
+#define LOOPING_FAN_OUT_H
+
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <exception>
+#include "looping_thread.hpp"
+
+class LoopingFanOut {
+	class ShardPool {
+		std::function<void(unsigned int)> routine_;
+		unsigned int shards_;
+		std::atomic<unsigned int> next_{0};
+		std::mutex mutex_;
+		std::condition_variable start_;
+		std::condition_variable done_;
+		uint64_t round_ = 0;
+		unsigned int busy_ = 0;
+		bool exiting_ = false;
+		std::exception_ptr error_;
+		std::vector<std::thread> threads_;
+
+		inline void process()
+		{
+			unsigned int shard;
+			while ((shard = next_.fetch_add(1, std::memory_order_relaxed)) < shards_) {
+				try {
+					routine_(shard);
+				} catch(...) {
+					std::unique_lock<std::mutex> lock(mutex_);
+					if (!error_)
+						error_ = std::current_exception();
+				}
+			}
+		}
+
+		inline void work()
+		{
+			uint64_t seen = 0;
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (true) {
+				start_.wait(lock, [&] { return exiting_ || round_ != seen; });
+				if (exiting_)
+					return;
+				seen = round_;
+				lock.unlock();
+				process();
+				lock.lock();
+				if (--busy_ == 0)
+					done_.notify_one();
+			}
+		}
+
+	public:
+		inline ShardPool(unsigned int shards, unsigned int threads, std::function<void(unsigned int)> routine) :
+			routine_(routine),
+			shards_(shards)
+		{
+			for (unsigned int i = 1; i < threads; i++)
+				threads_.emplace_back(&ShardPool::work, this);
+		}
+
+		inline ~ShardPool()
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				exiting_ = true;
+			}
+			start_.notify_all();
+			for (std::thread& thread : threads_)
+				thread.join();
+		}
+
+		/*!
+		* \brief Calls the routine for all shards and waits until the calls end, rethrows the first exception thrown by them
+		*/
+		inline void run()
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				next_.store(0, std::memory_order_relaxed);
+				busy_ = threads_.size();
+				round_++;
+			}
+			start_.notify_all();
+			process();
+			std::exception_ptr error;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				done_.wait(lock, [this] { return busy_ == 0; });
+				std::swap(error, error_);
+			}
+			if (error)
+				std::rethrow_exception(error);
+		}
+	};
+
+	ShardPool pool_;
+	LoopingThread loop_;
+
+public:
+	/*!
+	* \brief Constructs the threads and starts calling the routine periodically
+	* \param The calling period
+	* \param The number of shards, the routine is called with indexes from 0 to this number minus one every period
+	* \param The number of threads calling the routine, including the looping thread
+	* \param The function that is called for every shard
+	* \param If it starts running or is paused until resume() is called
+	*/
+	inline LoopingFanOut(std::chrono::steady_clock::duration period, unsigned int shards, unsigned int threads, std::function<void(unsigned int)> routine,
+			bool run = true) :
+		pool_(shards, threads, routine),
+		loop_(period, [this] { pool_.run(); }, run)
+	{
+
+	}
+
+	/*!
+	* \brief Pause the execution, will wait until the calls of the current period end
+	*/
+	inline void pause(bool resetTime = true)
+	{
+		loop_.pause(resetTime);
+	}
+
+	/*!
+	* \brief Resume paused execution
+	*/
+	inline void resume()
+	{
+		loop_.resume();
+	}
+
+	/*!
+	* \brief Tells it to stop without waiting for the calls of the current period to end
+	*/
+	inline void requestStop()
+	{
+		loop_.requestStop();
+	}
+
+	/*!
+	* \brief Stops it if it wasn't requested yet and waits until the calls of the current period end
+	*/
+	inline void join()
+	{
+		loop_.join();
+	}
+
+	/*!
+	* \brief Makes the calls for all shards as soon as possible without waiting for the regular time
+	*/
+	inline void notify()
+	{
+		loop_.notify();
+	}
+
+	/*!
+	* \brief Changes the period
+	* \param The new calling period
+	*/
+	inline void setPeriod(std::chrono::steady_clock::duration newPeriod)
+	{
+		loop_.setPeriod(newPeriod);
+	}
+
+	/*!
+	* \brief Enables or disables the catch up feature
+	* \param If it should be enabled
+	*/
+	inline void setCatchUp(bool catchUp)
+	{
+		loop_.setCatchUp(catchUp);
+	}
+
+	/*!
+	* \brief Sets what happens when the calls of a period take longer than the period
+	* \param The policy
+	*/
+	inline void setOverrunPolicy(LoopingOverrunPolicy policy)
+	{
+		loop_.setOverrunPolicy(policy);
+	}
+
+	/*!
+	* \brief Changes error callback
+	* \param errorCallback function which is called when exception is thrown in routine
+	*/
+	inline void setErrorCallback(std::function<void(const std::exception&)> errorCallback)
+	{
+		loop_.setErrorCallback(errorCallback);
+	}
+
+	/*!
+	* \brief Passes the errors to a reporter instead of the error callback
+	* \param The reporter, must outlive this object
+	* \param The name in the reported errors
+	* \param At most this many errors are reported per interval
+	* \param The interval, repetitions of the same error within it aren't reported
+	*/
+	inline void setErrorReporter(LoopingErrorReporter& reporter, const std::string& name, size_t burst = 10,
+			std::chrono::steady_clock::duration interval = std::chrono::seconds(1))
+	{
+		loop_.setErrorReporter(reporter, name, burst, interval);
+	}
+
+	/*!
+	* \brief Returns the statistics of the periods, run time covers the calls for all shards
+	*/
+	inline LoopingStats stats() const
+	{
+		return loop_.stats();
+	}
+
+	/*!
+	* \brief Registers it in a registry exporting its statistics, it's unregistered when destroyed
+	* \param The registry, must outlive this object
+	* \param The name in the exported statistics
+	*/
+	inline void setRegistry(LoopingRegistry& registry, const std::string& name)
+	{
+		loop_.setRegistry(registry, name);
+	}
+
+	/*!
+	* \brief Returns the number of periods in which the calls took longer than the period
+	*/
+	inline uint64_t overruns() const
+	{
+		return loop_.stats().overruns;
+	}
+};
+#endif // LOOPING_FAN_OUT_H
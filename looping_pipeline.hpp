@@ -0,0 +1,169 @@
+/*
+* \brief Bounded lock-free queue for passing data between looping threads that form a pipeline
+*
+* Every ring has one producer and one consumer, usually the routines of two looping threads. When connected to them, the ring wakes the consumer
+* up with notify() when data arrives into an empty ring and the producer when space is freed in a full ring, so a stage runs when it has work
+* to do or when its period elapses, whichever comes first. A producer that finds the ring full should stop producing until it's woken up again,
+* which propagates the backpressure from the slowest stage back to the source.
+*
+* \note A consumer is woken up only when the ring stops being empty, if its routine leaves some elements in the ring, they wait for its next period
+*/
+
+#ifndef LOOPING_PIPELINE_H
+#define LOOPING_PIPELINE_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstddef>
+#include <utility>
+#include "looping_cache_line.hpp"
+
+template <typename T>
+class LoopingRing {
+	std::unique_ptr<T[]> slots_;
+	size_t mask_;
+	// The counters only grow, the indexes into the slots are their lowest bits, the padding keeps them in separate cache lines
+	char padding0_[LOOPING_THREAD_CACHE_LINE];
+	std::atomic<size_t> head_{0};
+	char padding1_[LOOPING_THREAD_CACHE_LINE];
+	std::atomic<size_t> tail_{0};
+	char padding2_[LOOPING_THREAD_CACHE_LINE];
+	std::function<void()> wakeConsumer_;
+	std::function<void()> wakeProducer_;
+
+	static inline size_t roundUp(size_t capacity)
+	{
+		size_t rounded = 1;
+		while (rounded < capacity)
+			rounded <<= 1;
+		return rounded;
+	}
+
+public:
+	/*!
+	* \brief Constructs the ring
+	* \param The maximum number of elements, rounded up to a power of two
+	*/
+	inline explicit LoopingRing(size_t capacity) :
+		slots_(new T[roundUp(capacity)]),
+		mask_(roundUp(capacity) - 1)
+	{
+
+	}
+
+	LoopingRing(const LoopingRing&) = delete;
+	LoopingRing& operator=(const LoopingRing&) = delete;
+
+	/*!
+	* \brief Sets the looping threads that are woken up when the ring stops being empty or full
+	* \param The producer, anything with a notify() method, must outlive the use of the ring
+	* \param The consumer, anything with a notify() method, must outlive the use of the ring
+	*
+	* \note Must be called before any data is pushed
+	*/
+	template <typename Producer, typename Consumer>
+	inline void connect(Producer& producer, Consumer& consumer)
+	{
+		setProducer(producer);
+		setConsumer(consumer);
+	}
+
+	/*!
+	* \brief Sets the looping thread that is woken up when the ring stops being full
+	* \param The producer, anything with a notify() method, must outlive the use of the ring
+	*/
+	template <typename Producer>
+	inline void setProducer(Producer& producer)
+	{
+		wakeProducer_ = [&producer] { producer.notify(); };
+	}
+
+	/*!
+	* \brief Sets the looping thread that is woken up when the ring stops being empty
+	* \param The consumer, anything with a notify() method, must outlive the use of the ring
+	*/
+	template <typename Consumer>
+	inline void setConsumer(Consumer& consumer)
+	{
+		wakeConsumer_ = [&consumer] { consumer.notify(); };
+	}
+
+	/*!
+	* \brief Adds an element, may be called only by the producer
+	* \param The element, it's moved from only if it's added
+	* \return False if the ring was full and the element wasn't added
+	*/
+	inline bool push(T& element)
+	{
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - head_.load(std::memory_order_seq_cst) > mask_)
+			return false;
+		slots_[tail & mask_] = std::move(element);
+		tail_.store(tail + 1, std::memory_order_seq_cst);
+		// Both sides use sequentially consistent operations, so either the consumer sees the element or the producer sees the ring was empty
+		if (head_.load(std::memory_order_seq_cst) == tail && wakeConsumer_)
+			wakeConsumer_();
+		return true;
+	}
+
+	/*!
+	* \brief Adds an element, may be called only by the producer
+	* \param The element
+	* \return False if the ring was full and the element wasn't added
+	*/
+	inline bool push(T&& element)
+	{
+		return push(element);
+	}
+
+	/*!
+	* \brief Removes the oldest element, may be called only by the consumer
+	* \param Where the element is moved to
+	* \return False if the ring was empty
+	*/
+	inline bool pop(T& element)
+	{
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (tail_.load(std::memory_order_seq_cst) == head)
+			return false;
+		element = std::move(slots_[head & mask_]);
+		head_.store(head + 1, std::memory_order_seq_cst);
+		if (tail_.load(std::memory_order_seq_cst) - head > mask_ && wakeProducer_)
+			wakeProducer_();
+		return true;
+	}
+
+	/*!
+	* \brief Returns the number of elements, exact only if called by the producer or the consumer while the other isn't using the ring
+	*/
+	inline size_t size() const
+	{
+		return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+	}
+
+	/*!
+	* \brief Returns if there are no elements, exact if called by the consumer
+	*/
+	inline bool empty() const
+	{
+		return size() == 0;
+	}
+
+	/*!
+	* \brief Returns if no element can be added, exact if called by the producer
+	*/
+	inline bool full() const
+	{
+		return size() > mask_;
+	}
+
+	/*!
+	* \brief Returns the maximum number of elements
+	*/
+	inline size_t capacity() const
+	{
+		return mask_ + 1;
+	}
+};
+#endif // LOOPING_PIPELINE_H
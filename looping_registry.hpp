@@ -0,0 +1,153 @@
+/*
+* \brief Class for collecting the statistics of named loops and exporting them in the OpenMetrics text format
+*
+* Loops register themselves in a registry with setRegistry() and unregister when destroyed. Rendering reads the atomic counters and histograms
+* of the loops directly, so it never waits for their routines or blocks their threads, only registering and unregistering wait for it.
+*
+* \note The registry must outlive the loops registered in it
+*/
+
+#ifndef LOOPING_REGISTRY_H
+#define LOOPING_REGISTRY_H
+
+#include <mutex>
+#include <functional>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <ostream>
+#include <algorithm>
+#include <cstdint>
+#include "looping_stats.hpp"
+
+class LoopingRegistry {
+	struct Entry {
+		const void* owner;
+		std::string name;
+		const LoopingStatsRecorder* stats;
+		std::function<bool()> paused;
+	};
+
+	mutable std::mutex mutex_;
+	std::vector<Entry> entries_;
+
+	static inline std::string escape(const std::string& value)
+	{
+		std::string escaped;
+		for (char letter : value) {
+			if (letter == '\\')
+				escaped += "\\\\";
+			else if (letter == '"')
+				escaped += "\\\"";
+			else if (letter == '\n')
+				escaped += "\\n";
+			else
+				escaped += letter;
+		}
+		return escaped;
+	}
+
+	template <typename Value>
+	inline void writeFamily(std::ostream& out, const char* name, const char* type, const char* help, Value value) const
+	{
+		out << "# TYPE " << name << " " << type << "\n# HELP " << name << " " << help << "\n";
+		const char* suffix = std::string(type) == "counter" ? "_total" : "";
+		for (const Entry& entry : entries_)
+			out << name << suffix << "{loop=\"" << escape(entry.name) << "\"} " << value(entry) << "\n";
+	}
+
+	inline void writeHistogram(std::ostream& out, const char* name, const char* help, const LoopingHistogram& (LoopingStatsRecorder::*histogram)() const) const
+	{
+		out << "# TYPE " << name << " histogram\n# UNIT " << name << " seconds\n# HELP " << name << " " << help << "\n";
+		for (const Entry& entry : entries_) {
+			const LoopingHistogram& values = (entry.stats->*histogram)();
+			std::string labels = "loop=\"" + escape(entry.name) + "\"";
+			// Every scrape has the same bounds, the powers of two from about a microsecond, the buckets in between are counted in the next bound and the
+			// last bucket, which also holds all larger values, only in +Inf
+			uint64_t count = 0;
+			for (int i = 0; i < LoopingHistogram::Buckets; i++) {
+				count += values.bucket(i);
+				uint64_t bound = LoopingHistogram::bucketUpperBound(i);
+				if ((i + 1) % LoopingHistogram::SubBuckets || bound < 1024 || i == LoopingHistogram::Buckets - 1)
+					continue;
+				out << name << "_bucket{" << labels << ",le=\"" << bound / 1e9 << "\"} " << count << "\n";
+			}
+			out << name << "_bucket{" << labels << ",le=\"+Inf\"} " << count << "\n";
+			out << name << "_count{" << labels << "} " << count << "\n";
+			out << name << "_sum{" << labels << "} " << values.sum() / 1e9 << "\n";
+		}
+	}
+
+public:
+	inline LoopingRegistry()
+	{
+
+	}
+
+	LoopingRegistry(const LoopingRegistry&) = delete;
+	LoopingRegistry& operator=(const LoopingRegistry&) = delete;
+
+	/*!
+	* \brief Adds a loop, usually called by the loop itself
+	* \param The object identifying the loop when it's removed
+	* \param The name of the loop, used as the value of the loop label
+	* \param The statistics of the loop, must stay valid until the loop is removed
+	* \param Function returning if the loop is paused, callable from any thread
+	*/
+	inline void add(const void* owner, const std::string& name, const LoopingStatsRecorder& stats, std::function<bool()> paused)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		entries_.push_back(Entry{owner, name, &stats, paused});
+	}
+
+	/*!
+	* \brief Removes a loop, waits if the statistics are being rendered
+	* \param The object identifying the loop
+	*/
+	inline void remove(const void* owner)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [owner] (const Entry& entry) { return entry.owner == owner; }), entries_.end());
+	}
+
+	/*!
+	* \brief Returns the number of registered loops
+	*/
+	inline size_t size() const
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		return entries_.size();
+	}
+
+	/*!
+	* \brief Writes the statistics of all loops in the OpenMetrics text format, including the terminating # EOF line
+	* \param The stream to write to
+	*/
+	inline void writeOpenMetrics(std::ostream& out) const
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		writeFamily(out, "looping_ticks", "counter", "Calls of the routine.", [] (const Entry& entry) { return entry.stats->runTime().count(); });
+		writeFamily(out, "looping_missed_deadlines", "counter", "Calls that started more than one period late.",
+				[] (const Entry& entry) { return entry.stats->missedDeadlines(); });
+		writeFamily(out, "looping_overruns", "counter", "Calls that took longer than the period.", [] (const Entry& entry) { return entry.stats->overruns(); });
+		writeFamily(out, "looping_dropped_ticks", "counter", "Calls skipped to keep the schedule.", [] (const Entry& entry) { return entry.stats->droppedTicks(); });
+		writeFamily(out, "looping_errors", "counter", "Exceptions thrown by the routine.", [] (const Entry& entry) { return entry.stats->errors(); });
+		writeFamily(out, "looping_suppressed_errors", "counter", "Exceptions left out by the error rate limit.",
+				[] (const Entry& entry) { return entry.stats->suppressedErrors(); });
+		writeFamily(out, "looping_paused", "gauge", "Whether the loop is paused.", [] (const Entry& entry) { return entry.paused() ? 1 : 0; });
+		writeHistogram(out, "looping_lateness_seconds", "How much later than scheduled the calls started.", &LoopingStatsRecorder::lateness);
+		writeHistogram(out, "looping_run_time_seconds", "How long the calls took.", &LoopingStatsRecorder::runTime);
+		out << "# EOF\n";
+	}
+
+	/*!
+	* \brief Returns the statistics of all loops in the OpenMetrics text format
+	*/
+	inline std::string openMetrics() const
+	{
+		std::ostringstream out;
+		writeOpenMetrics(out);
+		return out.str();
+	}
+};
+#endif // LOOPING_REGISTRY_H
@@ -0,0 +1,286 @@
+/*
+* \brief Types describing what a looping routine returns and how it's called
+*
+* A routine can return nothing, in which case it's called with the regular period, or a LoopResult that tells when it should be called next.
+*
+* Since C++17, a routine can also accept a std::pmr::memory_resource&, an arena for allocations that only live during the call. It's a monotonic
+* buffer resource using a buffer owned by the looping thread, everything allocated from it is released at once after the routine returns.
+*
+* A routine accepting a const LoopTick& is called only once when it's late by several periods, and is told how many periods it covers. It can also
+* ask the LoopTick if it has used up its time budget for the call, and return LoopResult::Continue to carry on with the rest at the next tick.
+*/
+
+#ifndef LOOPING_ROUTINE_H
+#define LOOPING_ROUTINE_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include "looping_clock.hpp"
+// MSVC keeps __cplusplus at 199711L unless compiled with /Zc:__cplusplus, _MSVC_LANG has the standard it compiles
+#if (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define LOOPING_THREAD_ARENA
+#endif
+#endif
+
+/*!
+* \brief What a routine tells about when it should be called next
+*/
+struct LoopResult {
+	enum Action {
+		Regular, //!< Call it after the current period
+		RunAgainNow, //!< Call it again immediately, the schedule continues from that call
+		Busy, //!< There was work to do, shorten the period if adaptive period is enabled
+		Backoff, //!< There was nothing to do, lengthen the period if adaptive period is enabled
+		Delay, //!< Call it after the given delay, the period doesn't change
+		Continue //!< The work isn't finished, call it after the current period with LoopTick::continued set
+	};
+
+	Action action;
+	std::chrono::steady_clock::duration delay;
+
+	inline LoopResult(Action action = Regular) : action(action), delay(std::chrono::steady_clock::duration::zero())
+	{
+
+	}
+
+	template <typename Rep, typename Period>
+	inline LoopResult(std::chrono::duration<Rep, Period> delay) :
+		action(Delay), delay(std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay))
+	{
+
+	}
+};
+
+/*!
+* \brief Bounds and steps for changing the period according to Busy and Backoff results
+*
+* Backoff multiplies the period by the multiplier, Busy subtracts the step from it, or resets it to the minimum if the step is zero.
+* With a nonzero step, this is the additive increase, multiplicative decrease of the call rate.
+*
+* \note The minimum period must not be zero, otherwise multiplying it can't lengthen it
+*/
+struct LoopingBackoff {
+	std::chrono::steady_clock::duration minPeriod = std::chrono::steady_clock::duration::zero();
+	std::chrono::steady_clock::duration maxPeriod = std::chrono::steady_clock::duration::zero();
+	double multiplier = 2;
+	std::chrono::steady_clock::duration step = std::chrono::steady_clock::duration::zero();
+
+	/*!
+	* \brief Returns if the period is supposed to change at all
+	*/
+	inline bool enabled() const
+	{
+		return maxPeriod > minPeriod;
+	}
+
+	/*!
+	* \brief Returns the period after a Busy or Backoff result
+	* \param The current period
+	* \param The result
+	*/
+	inline std::chrono::steady_clock::duration adapt(std::chrono::steady_clock::duration period, LoopResult::Action action) const
+	{
+		if (action == LoopResult::Backoff) {
+			period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * multiplier);
+		} else if (action == LoopResult::Busy) {
+			period = step > std::chrono::steady_clock::duration::zero() ? period - step : minPeriod;
+		}
+		if (period < minPeriod)
+			return minPeriod;
+		if (period > maxPeriod)
+			return maxPeriod;
+		return period;
+	}
+};
+
+/*!
+* \brief Which ticks a call of a routine accepting it covers
+*
+* If the routine is late by several periods, it's called only once and the schedule continues after the last period it covers, as if it was called
+* for each of them.
+*/
+struct LoopTick {
+	uint64_t elapsed = 1; //!< The number of periods the call covers, zero if it's an extra call caused by notify()
+	std::chrono::steady_clock::time_point scheduled; //!< The time the earliest of the covered calls was scheduled at
+	std::chrono::steady_clock::time_point started; //!< The time the call actually started
+	std::chrono::steady_clock::duration budget = std::chrono::steady_clock::duration::zero(); //!< How long the call should take at most, zero if unlimited
+	bool continued = false; //!< If the previous call returned LoopResult::Continue
+	const LoopingManualClock* clock = nullptr; //!< The clock the times are measured by, null for std::chrono::steady_clock
+
+	/*!
+	* \brief Returns if the call has used up its budget and should return at the next point where it can stop, always false without a budget
+	*
+	* \note The routine should then return LoopResult::Continue and carry on from there at the next tick
+	*/
+	inline bool shouldYield() const
+	{
+		return budget > std::chrono::steady_clock::duration::zero() && (clock ? clock->now() : std::chrono::steady_clock::now()) - started >= budget;
+	}
+};
+
+namespace LoopingDetail {
+
+	/*!
+	* \brief What the looping thread provides to the routine for one call
+	*/
+	struct TickContext {
+		LoopTick tick;
+#if defined(LOOPING_THREAD_ARENA)
+		std::pmr::memory_resource* arena = nullptr;
+#endif
+	};
+
+	struct NoArgument {};
+	struct TickArgument {};
+	struct ArenaArgument {};
+
+	template <typename Function, typename = void>
+	struct TakesTick : std::false_type {};
+
+	template <typename Function>
+	struct TakesTick<Function, decltype(void(std::declval<Function&>()(std::declval<const LoopTick&>())))> : std::true_type {};
+
+	template <typename Function, typename = void>
+	struct TakesArena : std::false_type {};
+
+	template <typename Function>
+	inline auto invoke(Function& function, TickContext&, NoArgument) -> decltype(function())
+	{
+		return function();
+	}
+
+	template <typename Function>
+	inline auto invoke(Function& function, TickContext& context, TickArgument) -> decltype(function(context.tick))
+	{
+		return function(static_cast<const LoopTick&>(context.tick));
+	}
+
+#if defined(LOOPING_THREAD_ARENA)
+	template <typename Function>
+	struct TakesArena<Function, decltype(void(std::declval<Function&>()(std::declval<std::pmr::memory_resource&>())))> : std::true_type {};
+
+	template <typename Function>
+	inline auto invoke(Function& function, TickContext& context, ArenaArgument) -> decltype(function(*context.arena))
+	{
+		return function(*context.arena);
+	}
+#endif
+
+	template <typename Function>
+	using Argument = typename std::conditional<TakesTick<Function>::value, TickArgument,
+			typename std::conditional<TakesArena<Function>::value, ArenaArgument, NoArgument>::type>::type;
+
+	template <typename Function>
+	struct ReturnsResult : std::integral_constant<bool,
+			!std::is_void<decltype(invoke(std::declval<Function&>(), std::declval<TickContext&>(), Argument<Function>()))>::value> {};
+
+	template <typename Function>
+	inline LoopResult call(Function& function, TickContext& context, std::true_type)
+	{
+		return invoke(function, context, Argument<Function>());
+	}
+
+	template <typename Function>
+	inline LoopResult call(Function& function, TickContext& context, std::false_type)
+	{
+		invoke(function, context, Argument<Function>());
+		return LoopResult();
+	}
+
+	/*!
+	* \brief Calls the routine with the arguments it accepts and returns its result, or the regular result if it returns nothing
+	*/
+	template <typename Function>
+	inline LoopResult call(Function& function, TickContext& context)
+	{
+		return call(function, context, ReturnsResult<Function>());
+	}
+
+	/*!
+	* \brief Returns if the routine needs the arena
+	*/
+	template <typename Function>
+	inline bool usesArena(const Function&)
+	{
+		return std::is_same<Argument<Function>, ArenaArgument>::value;
+	}
+
+	/*!
+	* \brief Returns if the routine wants to be told which ticks it covers and called only once to catch up
+	*/
+	template <typename Function>
+	inline bool usesTick(const Function&)
+	{
+		return TakesTick<Function>::value;
+	}
+
+} // namespace LoopingDetail
+
+/*!
+* \brief A type-erased routine that may or may not return a LoopResult and may or may not accept an arena
+*/
+class LoopingRoutine {
+	std::function<LoopResult(LoopingDetail::TickContext&)> function_;
+	bool usesArena_ = false;
+	bool usesTick_ = false;
+
+public:
+	inline LoopingRoutine()
+	{
+
+	}
+
+	template <typename Function, typename = typename std::enable_if<!std::is_same<typename std::decay<Function>::type, LoopingRoutine>::value>::type>
+	inline LoopingRoutine(Function function) :
+		function_([function] (LoopingDetail::TickContext& context) mutable { return LoopingDetail::call(function, context); }),
+		usesArena_(std::is_same<LoopingDetail::Argument<Function>, LoopingDetail::ArenaArgument>::value),
+		usesTick_(LoopingDetail::TakesTick<Function>::value)
+	{
+
+	}
+
+	inline explicit operator bool() const
+	{
+		return bool(function_);
+	}
+
+	inline bool usesArena() const
+	{
+		return usesArena_;
+	}
+
+	inline bool usesTick() const
+	{
+		return usesTick_;
+	}
+
+	inline LoopResult operator()(LoopingDetail::TickContext& context)
+	{
+		return function_(context);
+	}
+};
+
+namespace LoopingDetail {
+
+	inline LoopResult call(LoopingRoutine& routine, TickContext& context)
+	{
+		return routine(context);
+	}
+
+	inline bool usesArena(const LoopingRoutine& routine)
+	{
+		return routine.usesArena();
+	}
+
+	inline bool usesTick(const LoopingRoutine& routine)
+	{
+		return routine.usesTick();
+	}
+
+} // namespace LoopingDetail
+#endif // LOOPING_ROUTINE_H
@@ -0,0 +1,623 @@
+/*
+* \brief Class for sharing a small pool of threads between many periodically called routines
+*
+* Every LoopingThread constructed with a reference to a scheduler registers a task in it instead of starting its own thread. The scheduler keeps
+* the tasks in min-heaps ordered by the latest time they should run at and its worker threads pick them up as they become due.
+*
+* By default, every worker has its own heap with its own lock and each task always goes to the same heap. A worker that is idle steals due tasks
+* from the heaps of workers that are busy running a routine, so a long routine doesn't delay the tasks that would be called by its worker, and
+* the workers don't contend for a single lock. The scheduler can also be constructed with one heap shared by all workers.
+*
+* Each task can have a slack, a tolerance for being called later than scheduled. A worker thread sleeps until the earliest time a task can't
+* be delayed any more and then calls all tasks that are due, which folds nearby deadlines into one wakeup.
+*
+* Tasks that are due are called in the order of their priority classes and then of their deadlines, so when the workers can't keep up,
+* the less important classes are delayed first. How late the tasks of each class are called is recorded.
+*
+* Constructed with a LoopingManualClock, the scheduler has no threads and calls the tasks from runUntil() and runFor() in simulated time.
+*
+* \note The scheduler must outlive all the LoopingThread instances using it
+*/
+
+#ifndef LOOPING_SCHEDULER_H
+#define LOOPING_SCHEDULER_H
+
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include "looping_stats.hpp"
+#include "looping_clock.hpp"
+
+/*!
+* \brief Priority classes of tasks in a LoopingScheduler, due tasks of a more important class are always called first
+*/
+enum class LoopingPriority {
+	Critical, //!< Heartbeats, lease renewals and anything else that must keep its cadence
+	High,
+	Normal, //!< The default
+	Low, //!< Work that can absorb lateness, like flushing metrics
+	Count //!< The number of classes, not a class
+};
+
+class LoopingScheduler {
+public:
+	/*!
+	* \brief A routine registered in the scheduler
+	*
+	* The callback is given the time it was scheduled at, also if it was called earlier because it was expedited, and has to return true and set it to
+	* the time of the next call if it's supposed to be called again.
+	*/
+	class Task {
+		friend class LoopingScheduler;
+		std::function<bool(std::chrono::steady_clock::time_point&)> fire_;
+		unsigned int generation_ = 0;
+		std::chrono::steady_clock::duration slack_ = std::chrono::steady_clock::duration::zero();
+		LoopingPriority priority_ = LoopingPriority::Normal;
+		bool running_ = false;
+		bool expedited_ = false;
+		bool deferred_ = false;
+		std::chrono::steady_clock::time_point deferredAt_;
+		std::chrono::steady_clock::time_point deferredScheduled_;
+		unsigned int deferredGeneration_ = 0;
+		std::function<void()> idleCallback_;
+	public:
+		inline Task(std::function<bool(std::chrono::steady_clock::time_point&)> fire = nullptr) : fire_(fire)
+		{
+
+		}
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+	};
+
+	/*!
+	* \brief How the due tasks are distributed between the worker threads
+	*/
+	enum class Queues {
+		PerWorker, //!< Every worker has its own heap and steals due tasks from the others when idle
+		Shared //!< All workers take tasks from one heap with one lock
+	};
+
+private:
+	struct Entry {
+		std::chrono::steady_clock::time_point at;
+		std::chrono::steady_clock::time_point deadline;
+		uint64_t sequence;
+		Task* task;
+		unsigned int generation;
+		LoopingPriority priority;
+		// The time the task was scheduled at, later than the time it's called at if it was expedited
+		std::chrono::steady_clock::time_point scheduled;
+
+		inline bool operator>(const Entry& other) const
+		{
+			return deadline > other.deadline || (deadline == other.deadline && sequence > other.sequence);
+		}
+	};
+
+	// Orders the entries that are due, earliest deadline first within a class
+	struct LessUrgent {
+		inline bool operator()(const Entry& first, const Entry& second) const
+		{
+			return first.priority > second.priority || (first.priority == second.priority && first > second);
+		}
+	};
+
+	// Heaps with the workers that sleep on them, everything about the tasks in them is guarded by its mutex
+	struct Shard {
+		std::vector<Entry> heap;
+		// The entries that are due, ordered by priority
+		std::vector<Entry> ready;
+		LoopingHistogram lateness[int(LoopingPriority::Count)];
+		uint64_t sequence = 0;
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		std::condition_variable idle;
+		uint64_t wakeups = 0;
+		std::atomic<unsigned int> waiting{0};
+		// The deadline of the earliest entry if no worker of this shard is waiting for it, so that other workers can steal it
+		std::atomic<std::chrono::steady_clock::rep> unattended{std::numeric_limits<std::chrono::steady_clock::rep>::max()};
+	};
+
+	unsigned int shardCount_;
+	std::unique_ptr<Shard[]> shards_;
+	std::atomic<bool> exiting_{false};
+	std::vector<std::thread> workers_;
+	LoopingManualClock* clock_ = nullptr;
+
+	inline unsigned int shardIndex(const Task& task) const
+	{
+		uint64_t address = reinterpret_cast<uintptr_t>(&task) >> 4;
+		return static_cast<unsigned int>(((address * 0x9E3779B97F4A7C15ull) >> 32) % shardCount_);
+	}
+
+	// Must be called with the shard's mutex locked
+	static inline void updateUnattended(Shard& shard)
+	{
+		std::chrono::steady_clock::rep unattended = std::numeric_limits<std::chrono::steady_clock::rep>::max();
+		if (shard.waiting.load(std::memory_order_relaxed) == 0) {
+			if (!shard.ready.empty())
+				unattended = shard.ready.front().at.time_since_epoch().count();
+			else if (!shard.heap.empty())
+				unattended = shard.heap.front().deadline.time_since_epoch().count();
+		}
+		shard.unattended.store(unattended, std::memory_order_release);
+	}
+
+	// Moves the entries that are due to the ready heap, must be called with the shard's mutex locked, returns if any entry is ready
+	static inline bool promote(Shard& shard, std::chrono::steady_clock::time_point now)
+	{
+		while (!shard.heap.empty() && shard.heap.front().at <= now) {
+			shard.ready.push_back(shard.heap.front());
+			std::push_heap(shard.ready.begin(), shard.ready.end(), LessUrgent());
+			std::pop_heap(shard.heap.begin(), shard.heap.end(), std::greater<Entry>());
+			shard.heap.pop_back();
+		}
+		return !shard.ready.empty();
+	}
+
+	// Must be called with the shard's mutex locked
+	static inline void rebuild(Shard& shard)
+	{
+		std::make_heap(shard.heap.begin(), shard.heap.end(), std::greater<Entry>());
+		std::make_heap(shard.ready.begin(), shard.ready.end(), LessUrgent());
+		updateUnattended(shard);
+	}
+
+	// Changes the task's entries in both heaps, must be called with the shard's mutex locked
+	template <typename Change>
+	static inline void update(Shard& shard, Task& task, Change change)
+	{
+		bool changed = false;
+		for (std::vector<Entry>* entries : { &shard.heap, &shard.ready }) {
+			for (Entry& entry : *entries) {
+				if (entry.task == &task) {
+					change(entry);
+					changed = true;
+				}
+			}
+		}
+		if (changed)
+			rebuild(shard);
+	}
+
+	// Must be called with the shard's mutex locked, returns if the entry is the earliest one
+	inline bool push(Shard& shard, Task& task, std::chrono::steady_clock::time_point scheduled, std::chrono::steady_clock::time_point at)
+	{
+		shard.heap.push_back(Entry{at, at + task.slack_, shard.sequence++, &task, task.generation_, task.priority_, scheduled});
+		std::push_heap(shard.heap.begin(), shard.heap.end(), std::greater<Entry>());
+		updateUnattended(shard);
+		return shard.heap.front().task == &task;
+	}
+
+	// Must be called with the shard's mutex locked
+	inline void remove(Shard& shard, Task& task)
+	{
+		task.generation_++;
+		task.deferred_ = false;
+		auto belongs = [&task] (const Entry& entry) { return entry.task == &task; };
+		auto removed = std::remove_if(shard.heap.begin(), shard.heap.end(), belongs);
+		auto removedReady = std::remove_if(shard.ready.begin(), shard.ready.end(), belongs);
+		if (removed != shard.heap.end() || removedReady != shard.ready.end()) {
+			shard.heap.erase(removed, shard.heap.end());
+			shard.ready.erase(removedReady, shard.ready.end());
+			rebuild(shard);
+		}
+	}
+
+	// Wakes up a worker of another shard that is waiting, so that it can steal from this shard, must be called without any mutex locked
+	inline void lendShard(unsigned int index)
+	{
+		for (unsigned int i = 1; i < shardCount_; i++) {
+			Shard& other = shards_[(index + i) % shardCount_];
+			if (other.waiting.load(std::memory_order_acquire) > 0) {
+				// Locking prevents the notification from getting lost between computing the wait time and starting to wait
+				{
+					std::unique_lock<std::mutex> lock(other.mutex);
+				}
+				other.wakeup.notify_one();
+				return;
+			}
+		}
+	}
+
+	// Must be called without any mutex locked
+	inline void wakeUp(unsigned int index)
+	{
+		Shard& shard = shards_[index];
+		if (shard.waiting.load(std::memory_order_acquire) > 0)
+			shard.wakeup.notify_one();
+		else
+			lendShard(index);
+	}
+
+	// Calls the most urgent ready task of the shard, must be called with its mutex locked and a task ready, returns with the mutex locked again
+	inline void run(unsigned int index, std::unique_lock<std::mutex>& lock, unsigned int ownIndex, std::chrono::steady_clock::time_point now)
+	{
+		Shard& shard = shards_[index];
+		Entry next = shard.ready.front();
+		std::pop_heap(shard.ready.begin(), shard.ready.end(), LessUrgent());
+		shard.ready.pop_back();
+		updateUnattended(shard);
+
+		Task& task = *next.task;
+		if (task.running_) {
+			// Rescheduled while its previous call hasn't ended yet, it can't run in parallel with itself
+			task.deferred_ = true;
+			task.deferredAt_ = next.at;
+			task.deferredScheduled_ = next.scheduled;
+			task.deferredGeneration_ = next.generation;
+			return;
+		}
+		task.running_ = true;
+		shard.lateness[int(next.priority)].record(now > next.at ? std::chrono::duration_cast<std::chrono::nanoseconds>(now - next.at).count() : 0);
+		bool handOff = !shard.heap.empty() || !shard.ready.empty();
+		lock.unlock();
+		// Someone else has to take care of the tasks that become due while this one is running
+		if (handOff)
+			wakeUp(index);
+		if (ownIndex != index && shards_[ownIndex].unattended.load(std::memory_order_acquire) != std::numeric_limits<std::chrono::steady_clock::rep>::max())
+			lendShard(ownIndex);
+		std::chrono::steady_clock::time_point at = next.scheduled;
+		bool again = task.fire_(at);
+		lock.lock();
+		// The callbacks are called before the task stops being running, so that whatever they use can't be destroyed meanwhile
+		while (task.idleCallback_) {
+			std::function<void()> idleCallback;
+			std::swap(idleCallback, task.idleCallback_);
+			lock.unlock();
+			idleCallback();
+			lock.lock();
+		}
+		task.running_ = false;
+		bool earliest = false;
+		if (again && task.generation_ == next.generation) {
+			std::chrono::steady_clock::time_point wakeAt = at;
+			if (task.expedited_) {
+				std::chrono::steady_clock::time_point now = this->now();
+				if (now < wakeAt)
+					wakeAt = now;
+			}
+			earliest = push(shard, task, at, wakeAt);
+		}
+		task.expedited_ = false;
+		if (task.deferred_) {
+			if (task.generation_ == task.deferredGeneration_)
+				earliest = push(shard, task, task.deferredScheduled_, task.deferredAt_) || earliest;
+			task.deferred_ = false;
+		}
+		shard.idle.notify_all();
+		// The shard's own worker may be sleeping until a later time
+		if (earliest && ownIndex != index) {
+			lock.unlock();
+			wakeUp(index);
+			lock.lock();
+		}
+	}
+
+	// Calls one due task of a shard nobody is waiting for, returns if it found any
+	inline bool steal(unsigned int ownIndex, std::chrono::steady_clock::time_point now)
+	{
+		for (unsigned int i = 1; i < shardCount_; i++) {
+			unsigned int index = (ownIndex + i) % shardCount_;
+			Shard& shard = shards_[index];
+			if (shard.unattended.load(std::memory_order_acquire) > now.time_since_epoch().count())
+				continue;
+			std::unique_lock<std::mutex> lock(shard.mutex);
+			if (shard.waiting.load(std::memory_order_relaxed) == 0 && promote(shard, now)) {
+				run(index, lock, ownIndex, now);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline void work(unsigned int ownIndex)
+	{
+		Shard& shard = shards_[ownIndex];
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		while (!exiting_.load(std::memory_order_acquire)) {
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			// No task needs to be called before the earliest deadline, but once awake, all tasks that are due are called
+			if (promote(shard, now)) {
+				run(ownIndex, lock, ownIndex, now);
+				continue;
+			}
+			if (shardCount_ > 1) {
+				lock.unlock();
+				bool stolen = steal(ownIndex, now);
+				lock.lock();
+				if (stolen)
+					continue;
+			}
+
+			std::chrono::steady_clock::time_point sleepUntil = shard.heap.empty() ? std::chrono::steady_clock::time_point::max() : shard.heap.front().deadline;
+			shard.waiting.fetch_add(1, std::memory_order_acq_rel);
+			updateUnattended(shard);
+			for (unsigned int i = 1; i < shardCount_; i++) {
+				std::chrono::steady_clock::time_point unattended(std::chrono::steady_clock::duration(
+						shards_[(ownIndex + i) % shardCount_].unattended.load(std::memory_order_acquire)));
+				sleepUntil = std::min(sleepUntil, unattended);
+			}
+			if (!exiting_.load(std::memory_order_acquire)) {
+				if (sleepUntil == std::chrono::steady_clock::time_point::max())
+					shard.wakeup.wait(lock);
+				else
+					shard.wakeup.wait_until(lock, sleepUntil);
+			}
+			shard.wakeups++;
+			shard.waiting.fetch_sub(1, std::memory_order_acq_rel);
+			updateUnattended(shard);
+		}
+	}
+public:
+
+	/*!
+	* \brief Constructs the scheduler and starts its worker threads
+	* \param The number of worker threads, at least one is always started
+	* \param If each worker has its own heap of tasks or all share one
+	*/
+	inline explicit LoopingScheduler(unsigned int threads = std::thread::hardware_concurrency(), Queues queues = Queues::PerWorker)
+	{
+		if (threads == 0)
+			threads = 1;
+		shardCount_ = queues == Queues::PerWorker ? threads : 1;
+		shards_.reset(new Shard[shardCount_]);
+		for (unsigned int i = 0; i < threads; i++)
+			workers_.emplace_back(&LoopingScheduler::work, this, i % shardCount_);
+	}
+
+	/*!
+	* \brief Constructs the scheduler without threads, the tasks are called by runUntil() and runFor() and the clock is advanced between them
+	* \param The clock, must outlive the scheduler, the routines using the scheduler see its time
+	*/
+	inline explicit LoopingScheduler(LoopingManualClock& clock) :
+		shardCount_(1),
+		shards_(new Shard[1]),
+		clock_(&clock)
+	{
+
+	}
+
+	LoopingScheduler(const LoopingScheduler&) = delete;
+	LoopingScheduler& operator=(const LoopingScheduler&) = delete;
+
+	/*!
+	* \brief The destructor, waits for the routines that are running, but doesn't call any more of them
+	*/
+	inline ~LoopingScheduler()
+	{
+		exiting_.store(true, std::memory_order_release);
+		for (unsigned int i = 0; i < shardCount_; i++) {
+			{
+				std::unique_lock<std::mutex> lock(shards_[i].mutex);
+			}
+			shards_[i].wakeup.notify_all();
+		}
+		for (std::thread& worker : workers_)
+			worker.join();
+	}
+
+	/*!
+	* \brief Schedules a task to be called at a given time
+	* \param The task
+	* \param The time when it should be called
+	*/
+	inline void schedule(Task& task, std::chrono::steady_clock::time_point at)
+	{
+		schedule(task, at, at);
+	}
+
+	/*!
+	* \brief Schedules a task to be called earlier than the time it's given
+	* \param The task
+	* \param The time given to the task
+	* \param The time when it should be called
+	*/
+	inline void schedule(Task& task, std::chrono::steady_clock::time_point scheduled, std::chrono::steady_clock::time_point at)
+	{
+		unsigned int index = shardIndex(task);
+		{
+			std::unique_lock<std::mutex> lock(shards_[index].mutex);
+			if (!push(shards_[index], task, scheduled, at))
+				return;
+		}
+		wakeUp(index);
+	}
+
+	/*!
+	* \brief Moves the next call of a scheduled task to an earlier time, does nothing if it's not scheduled
+	* \param The task
+	* \param The time when it should be called if it's later than this
+	*
+	* \note The task is still given the time it was scheduled at. If the task is running, it's rescheduled to run right after it ends
+	*/
+	inline void expedite(Task& task, std::chrono::steady_clock::time_point at)
+	{
+		unsigned int index = shardIndex(task);
+		Shard& shard = shards_[index];
+		{
+			std::unique_lock<std::mutex> lock(shard.mutex);
+			if (task.running_) {
+				task.expedited_ = true;
+				return;
+			}
+			auto found = std::find_if(shard.heap.begin(), shard.heap.end(), [&task] (const Entry& entry) { return entry.task == &task; });
+			if (found == shard.heap.end() || found->at <= at)
+				return;
+			found->at = at;
+			found->deadline = at + task.slack_;
+			rebuild(shard);
+		}
+		wakeUp(index);
+	}
+
+	/*!
+	* \brief Removes the task from the schedule, will wait until the task's call ends if it's running
+	* \param The task
+	*
+	* \note Must not be called from the task itself
+	*/
+	inline void cancel(Task& task)
+	{
+		Shard& shard = shards_[shardIndex(task)];
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		remove(shard, task);
+		shard.idle.wait(lock, [&task] { return !task.running_; });
+	}
+
+	/*!
+	* \brief Removes the task from the schedule without waiting for its call to end
+	* \param The task
+	* \param Function called when the task isn't running, immediately if it's not running now, otherwise by the worker thread after the call,
+	* can be empty
+	*/
+	inline void cancelAsync(Task& task, std::function<void()> idleCallback)
+	{
+		Shard& shard = shards_[shardIndex(task)];
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		remove(shard, task);
+		if (!idleCallback)
+			return;
+		if (task.running_) {
+			if (task.idleCallback_) {
+				std::function<void()> previous = task.idleCallback_;
+				task.idleCallback_ = [previous, idleCallback] {
+					previous();
+					idleCallback();
+				};
+			} else {
+				task.idleCallback_ = idleCallback;
+			}
+			return;
+		}
+		lock.unlock();
+		idleCallback();
+	}
+
+	/*!
+	* \brief Sets how much later than scheduled the task may be called, so that its call can share a wakeup with others
+	* \param The task
+	* \param The slack, zero by default
+	*/
+	inline void setSlack(Task& task, std::chrono::steady_clock::duration slack)
+	{
+		Shard& shard = shards_[shardIndex(task)];
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		task.slack_ = slack;
+		update(shard, task, [slack] (Entry& entry) { entry.deadline = entry.at + slack; });
+	}
+
+	/*!
+	* \brief Sets the priority class of the task, its due calls wait until no task of a more important class is due
+	* \param The task
+	* \param The class, Normal by default
+	*/
+	inline void setPriority(Task& task, LoopingPriority priority)
+	{
+		Shard& shard = shards_[shardIndex(task)];
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		task.priority_ = priority;
+		update(shard, task, [priority] (Entry& entry) { entry.priority = priority; });
+	}
+
+	/*!
+	* \brief Returns how late the calls of the tasks of a priority class started, since the scheduler was constructed
+	* \param The class
+	*/
+	inline LoopingStats::Distribution lateness(LoopingPriority priority) const
+	{
+		LoopingHistogram merged;
+		for (unsigned int i = 0; i < shardCount_; i++)
+			merged.merge(shards_[i].lateness[int(priority)]);
+		return LoopingStatsRecorder::distribution(merged);
+	}
+
+	/*!
+	* \brief Returns the current time of the scheduler's clock, the manual clock if it has one
+	*/
+	inline std::chrono::steady_clock::time_point now() const
+	{
+		return clock_ ? clock_->now() : std::chrono::steady_clock::now();
+	}
+
+	/*!
+	* \brief Returns the manual clock, null if the scheduler uses std::chrono::steady_clock
+	*/
+	inline const LoopingManualClock* manualClock() const
+	{
+		return clock_;
+	}
+
+	/*!
+	* \brief Calls the tasks that are due until a given time on the calling thread, advancing the manual clock to each deadline without waiting
+	* \param The time, the clock shows it afterwards
+	* \return The number of calls
+	*
+	* \note Requires the scheduler to be constructed with a manual clock, the tasks due at the same time are called in the same order every time
+	*/
+	inline uint64_t runUntil(std::chrono::steady_clock::time_point until)
+	{
+		if (!clock_)
+			throw std::logic_error("Running a LoopingScheduler that doesn't have a manual clock");
+		Shard& shard = shards_[0];
+		uint64_t calls = 0;
+		std::unique_lock<std::mutex> lock(shard.mutex);
+		while (true) {
+			std::chrono::steady_clock::time_point now = clock_->now();
+			if (promote(shard, now)) {
+				run(0, lock, 0, now);
+				calls++;
+				continue;
+			}
+			if (shard.heap.empty() || shard.heap.front().deadline > until)
+				break;
+			// Like the worker threads, it wakes up at the deadline and calls everything that is due by then
+			clock_->advanceTo(shard.heap.front().deadline);
+		}
+		clock_->advanceTo(until);
+		shard.wakeups++;
+		return calls;
+	}
+
+	/*!
+	* \brief Calls the tasks that are due within a given duration, like runUntil()
+	* \param The duration of simulated time
+	* \return The number of calls
+	*/
+	inline uint64_t runFor(std::chrono::steady_clock::duration duration)
+	{
+		return runUntil(now() + duration);
+	}
+
+	/*!
+	* \brief Returns how many times the worker threads woke up, including spurious wakeups
+	*/
+	inline uint64_t wakeups()
+	{
+		uint64_t total = 0;
+		for (unsigned int i = 0; i < shardCount_; i++) {
+			std::unique_lock<std::mutex> lock(shards_[i].mutex);
+			total += shards_[i].wakeups;
+		}
+		return total;
+	}
+
+	/*!
+	* \brief Returns the number of worker threads
+	*/
+	inline unsigned int threadCount() const
+	{
+		return workers_.size();
+	}
+};
+#endif // LOOPING_SCHEDULER_H
@@ -0,0 +1,332 @@
+/*
+* \brief Classes for collecting statistics about the calls of a periodic routine
+*
+* The histograms have fixed buckets whose width grows with the magnitude of the values, so that the relative error of the reported percentiles
+* stays within 25%. They are updated with atomic operations, so they can be read from another thread without stopping the one that writes them.
+*
+* \note Only one thread can be recording at a time, a snapshot read while recording can be off by the values being recorded
+*/
+
+#ifndef LOOPING_STATS_H
+#define LOOPING_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+class LoopingHistogram {
+public:
+	static constexpr int SubBuckets = 4;
+	static constexpr int MaxMagnitude = 40;
+	static constexpr int Buckets = SubBuckets + (MaxMagnitude - 2) * SubBuckets;
+
+private:
+	std::atomic<uint64_t> buckets_[Buckets];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sum_;
+	std::atomic<uint64_t> min_;
+	std::atomic<uint64_t> max_;
+
+	static inline void increase(std::atomic<uint64_t>& counter, uint64_t value)
+	{
+		// There is only one writer, so a read-modify-write instruction isn't necessary
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	static inline int magnitude(uint64_t value)
+	{
+#if defined(__GNUC__)
+		return 63 - __builtin_clzll(value);
+#else
+		int result = 0;
+		while (value >>= 1)
+			result++;
+		return result;
+#endif
+	}
+
+	static inline int bucketOf(uint64_t value)
+	{
+		if (value < uint64_t(SubBuckets))
+			return int(value);
+		int shift = magnitude(value) - 2;
+		int index = (shift + 1) * SubBuckets + int((value >> shift) & (SubBuckets - 1));
+		return index < Buckets ? index : Buckets - 1;
+	}
+
+public:
+	inline LoopingHistogram()
+	{
+		reset();
+	}
+
+	LoopingHistogram(const LoopingHistogram&) = delete;
+	LoopingHistogram& operator=(const LoopingHistogram&) = delete;
+
+	/*!
+	* \brief Adds a value
+	* \param The value in nanoseconds
+	*/
+	inline void record(uint64_t value)
+	{
+		increase(buckets_[bucketOf(value)], 1);
+		increase(count_, 1);
+		increase(sum_, value);
+		if (value < min_.load(std::memory_order_relaxed))
+			min_.store(value, std::memory_order_relaxed);
+		if (value > max_.load(std::memory_order_relaxed))
+			max_.store(value, std::memory_order_relaxed);
+	}
+
+	/*!
+	* \brief Adds all values of another histogram
+	* \param The other histogram, it may be being written meanwhile
+	*/
+	inline void merge(const LoopingHistogram& other)
+	{
+		for (int i = 0; i < Buckets; i++)
+			increase(buckets_[i], other.bucket(i));
+		increase(count_, other.count());
+		increase(sum_, other.sum());
+		if (other.count() && other.min() < min_.load(std::memory_order_relaxed))
+			min_.store(other.min(), std::memory_order_relaxed);
+		if (other.max() > max_.load(std::memory_order_relaxed))
+			max_.store(other.max(), std::memory_order_relaxed);
+	}
+
+	/*!
+	* \brief Removes all values
+	*/
+	inline void reset()
+	{
+		for (std::atomic<uint64_t>& bucket : buckets_)
+			bucket.store(0, std::memory_order_relaxed);
+		count_.store(0, std::memory_order_relaxed);
+		sum_.store(0, std::memory_order_relaxed);
+		min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+		max_.store(0, std::memory_order_relaxed);
+	}
+
+	inline uint64_t count() const
+	{
+		return count_.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t sum() const
+	{
+		return sum_.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t min() const
+	{
+		return count() ? min_.load(std::memory_order_relaxed) : 0;
+	}
+
+	inline uint64_t max() const
+	{
+		return max_.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t mean() const
+	{
+		uint64_t values = count();
+		return values ? sum() / values : 0;
+	}
+
+	/*!
+	* \brief Returns the number of values in a bucket
+	* \param Index of the bucket, below Buckets
+	*/
+	inline uint64_t bucket(int index) const
+	{
+		return buckets_[index].load(std::memory_order_relaxed);
+	}
+
+	/*!
+	* \brief Returns the smallest value that doesn't fit into the bucket
+	* \param Index of the bucket, below Buckets
+	*/
+	static inline uint64_t bucketUpperBound(int index)
+	{
+		if (index < SubBuckets)
+			return uint64_t(index) + 1;
+		int shift = index / SubBuckets - 1;
+		return (uint64_t(SubBuckets + index % SubBuckets) + 1) << shift;
+	}
+
+	/*!
+	* \brief Returns the value below which the given fraction of values is
+	* \param The fraction, between 0 and 1
+	*
+	* \note The result is the upper bound of the bucket the percentile falls into, clamped by the maximum
+	*/
+	inline uint64_t percentile(double fraction) const
+	{
+		uint64_t total = 0;
+		for (int i = 0; i < Buckets; i++)
+			total += bucket(i);
+		if (total == 0)
+			return 0;
+		uint64_t threshold = uint64_t(fraction * total + 0.5);
+		if (threshold == 0)
+			threshold = 1;
+		uint64_t seen = 0;
+		for (int i = 0; i < Buckets; i++) {
+			seen += bucket(i);
+			if (seen >= threshold) {
+				uint64_t bound = bucketUpperBound(i) - 1;
+				return bound < max() ? bound : max();
+			}
+		}
+		return max();
+	}
+};
+
+/*!
+* \brief A snapshot of the statistics of a looping routine
+*/
+struct LoopingStats {
+	struct Distribution {
+		std::chrono::nanoseconds min;
+		std::chrono::nanoseconds mean;
+		std::chrono::nanoseconds max;
+		std::chrono::nanoseconds p99;
+	};
+
+	uint64_t count = 0; //!< Number of calls of the routine
+	uint64_t missedDeadlines = 0; //!< Number of calls that started later than one period after the time they were scheduled at
+	uint64_t overruns = 0; //!< Number of calls that took longer than the period
+	uint64_t droppedTicks = 0; //!< Number of calls skipped because of an overrun or because catching up would exceed the maximum lag
+	uint64_t errors = 0; //!< Number of exceptions thrown by the routine and the callbacks
+	uint64_t suppressedErrors = 0; //!< Number of errors that weren't reported because of the rate limit of an error reporter
+	Distribution lateness = {}; //!< How much later than scheduled the calls started
+	Distribution runTime = {}; //!< How long the calls took
+};
+
+/*!
+* \brief Records the statistics of a looping routine, written by the thread calling the routine and readable from any thread
+*/
+class LoopingStatsRecorder {
+	LoopingHistogram lateness_;
+	LoopingHistogram runTime_;
+	std::atomic<uint64_t> missedDeadlines_{0};
+	std::atomic<uint64_t> droppedTicks_{0};
+	std::atomic<uint64_t> overruns_{0};
+	std::atomic<uint64_t> errors_{0};
+	std::atomic<uint64_t> suppressedErrors_{0};
+
+	static inline uint64_t nanoseconds(std::chrono::steady_clock::duration duration)
+	{
+		return duration.count() > 0 ? std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() : 0;
+	}
+
+public:
+	/*!
+	* \brief Summarises a histogram
+	* \param The histogram
+	*/
+	static inline LoopingStats::Distribution distribution(const LoopingHistogram& histogram)
+	{
+		LoopingStats::Distribution result;
+		result.min = std::chrono::nanoseconds(histogram.min());
+		result.mean = std::chrono::nanoseconds(histogram.mean());
+		result.max = std::chrono::nanoseconds(histogram.max());
+		result.p99 = std::chrono::nanoseconds(histogram.percentile(0.99));
+		return result;
+	}
+
+	/*!
+	* \brief Records one call of the routine
+	* \param The time the call was scheduled at
+	* \param The time the call started
+	* \param The time the call ended
+	* \param The period of the routine
+	*/
+	inline void record(std::chrono::steady_clock::time_point scheduled, std::chrono::steady_clock::time_point started,
+			std::chrono::steady_clock::time_point ended, std::chrono::steady_clock::duration period)
+	{
+		lateness_.record(nanoseconds(started - scheduled));
+		runTime_.record(nanoseconds(ended - started));
+		if (period > std::chrono::steady_clock::duration::zero() && started - scheduled > period)
+			missedDeadlines_.store(missedDeadlines_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	/*!
+	* \brief Records calls that were skipped
+	* \param Their number
+	*/
+	inline void recordDropped(uint64_t ticks)
+	{
+		droppedTicks_.store(droppedTicks_.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+	}
+
+	/*!
+	* \brief Records a call that took longer than the period
+	*/
+	inline void recordOverrun()
+	{
+		overruns_.store(overruns_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	/*!
+	* \brief Records an error
+	* \param If it wasn't reported
+	*/
+	inline void recordError(bool suppressed)
+	{
+		errors_.store(errors_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (suppressed)
+			suppressedErrors_.store(suppressedErrors_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	inline const LoopingHistogram& lateness() const
+	{
+		return lateness_;
+	}
+
+	inline const LoopingHistogram& runTime() const
+	{
+		return runTime_;
+	}
+
+	inline uint64_t missedDeadlines() const
+	{
+		return missedDeadlines_.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t droppedTicks() const
+	{
+		return droppedTicks_.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t overruns() const
+	{
+		return overruns_.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t errors() const
+	{
+		return errors_.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t suppressedErrors() const
+	{
+		return suppressedErrors_.load(std::memory_order_relaxed);
+	}
+
+	inline LoopingStats snapshot() const
+	{
+		LoopingStats result;
+		result.count = runTime_.count();
+		result.missedDeadlines = missedDeadlines();
+		result.overruns = overruns();
+		result.droppedTicks = droppedTicks();
+		result.errors = errors();
+		result.suppressedErrors = suppressedErrors();
+		result.lateness = distribution(lateness_);
+		result.runTime = distribution(runTime_);
+		return result;
+	}
+};
+#endif // LOOPING_STATS_H
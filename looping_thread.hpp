@@ -4,7 +4,16 @@
 * The period is the period of calling the routine, not the wait between the calls. It doesn't wait for this period when it's being destroyed, but it waits
 * while the routine is running.
 *
-* \note The waiting is implemented using std::timed_mutex
+* \note The waiting is implemented using std::condition_variable, the state is a single atomic variable
+*
+* If constructed with a LoopingScheduler, it doesn't start its own thread and the routine is called by one of the scheduler's threads instead.
+* If constructed with a LoopingThreadPool, it takes a thread from the pool instead of creating one and gives it back when destroyed.
+*
+* LoopingThread stores the routine as std::function, BasicLoopingThread can store any callable type without type erasure.
+*
+* The routine can return a LoopResult to call it again immediately, after a specific delay or to lengthen or shorten the period within bounds.
+* Since C++17, it can accept a std::pmr::memory_resource& for allocations that are released after each call. If it accepts a const LoopTick&,
+* it's called only once to catch up with several periods.
 */
 
 #ifndef LOOPING_THREAD_H
@@ -13,169 +22,1336 @@
 #include <thread>
 #include <functional>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <vector>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <algorithm>
+#include <random>
+#include <future>
+#include <exception>
+#include "looping_routine.hpp"
+#include "looping_scheduler.hpp"
+#include "looping_stats.hpp"
+#include "looping_trace.hpp"
+#include "looping_registry.hpp"
+#include "looping_watchdog.hpp"
+#include "looping_thread_pool.hpp"
+#include "looping_errors.hpp"
+#include "looping_cache_line.hpp"
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__linux__)
+#include <sys/prctl.h>
+#include <cerrno>
+#endif
 
-class LoopingThread {
-	std::chrono::steady_clock::duration period_;
-	std::function<void()> routine_;
-	std::function<void(const std::exception&)> errorCallback_;
-	std::timed_mutex waitMutex_;
-	std::unique_lock<std::timed_mutex> waitLock_;
-	std::mutex pauseMutex_;
-	std::unique_lock<std::mutex> pauseLock_;
-	std::mutex resumeMutex_;
-	std::unique_lock<std::mutex> resumeLock_;
-	bool exiting_ = false;
-	bool paused_;
-	bool resetTimeOnPause_ = true;
-	bool catchUp_ = true;
-	std::thread worker_;
-	
-	inline void work()
+/*!
+* \brief Properties of the worker thread, applied by the worker itself before the routine is called for the first time
+*
+* \note Affinity and timer slack are supported only on Linux, scheduling policies and names on Linux and macOS, they are ignored elsewhere
+*/
+struct LoopingThreadOptions {
+	enum class Scheduling {
+		Default, //!< Leave the scheduling policy unchanged
+		Fifo, //!< SCHED_FIFO, usually requires elevated privileges
+		RoundRobin //!< SCHED_RR, usually requires elevated privileges
+	};
+
+	std::vector<unsigned int> cpus; //!< The CPUs the thread may run on, any if empty
+	Scheduling scheduling = Scheduling::Default;
+	int priority = 0; //!< The priority used with Fifo or RoundRobin
+	std::string name; //!< The name of the thread, Linux truncates it to 15 characters
+	std::chrono::nanoseconds timerSlack = std::chrono::nanoseconds::zero(); //!< How much later the thread may be woken up, left unchanged if zero
+
+	/*!
+	* \brief Applies the options to the calling thread
+	*
+	* \note Throws std::system_error if the operating system rejects any of them
+	*/
+	inline void apply() const
 	{
-		std::chrono::steady_clock::time_point awakenAt = std::chrono::steady_clock::now();
-		while (true) {
-			bool interrupted = false;
+#if defined(__linux__)
+		if (!cpus.empty()) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for (unsigned int cpu : cpus)
+				CPU_SET(cpu, &set);
+			int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			if (error)
+				throw std::system_error(error, std::system_category(), "Could not set the affinity of a looping thread");
+		}
+		if (timerSlack > std::chrono::nanoseconds::zero() && prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(timerSlack.count()), 0, 0, 0) != 0)
+			throw std::system_error(errno, std::system_category(), "Could not set the timer slack of a looping thread");
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+		if (scheduling != Scheduling::Default) {
+			sched_param parameters = {};
+			parameters.sched_priority = priority;
+			int error = pthread_setschedparam(pthread_self(), scheduling == Scheduling::Fifo ? SCHED_FIFO : SCHED_RR, &parameters);
+			if (error)
+				throw std::system_error(error, std::system_category(), "Could not set the scheduling policy of a looping thread");
+		}
+		if (!name.empty()) {
+#if defined(__linux__)
+			int error = pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#else
+			int error = pthread_setname_np(name.c_str());
+#endif
+			if (error)
+				throw std::system_error(error, std::system_category(), "Could not set the name of a looping thread");
+		}
+#endif
+	}
+};
+
+/*!
+* \brief How the thread waits for the time of the next call
+*/
+enum class LoopingWakeupPolicy {
+	Sleep, //!< Sleeps until the deadline, the cheapest but the least precise
+	SleepThenSpin, //!< Sleeps until a margin before the deadline and busy-waits for the rest
+	Spin //!< Busy-waits all the time, occupies a whole core
+};
+
+/*!
+* \brief What happens when a call of the routine takes longer than the period
+*/
+enum class LoopingOverrunPolicy {
+	RunImmediately, //!< Call it again right away, as many times as the schedule requires
+	SkipToNextSlot, //!< Skip the calls whose time has passed and continue with the next one in the schedule
+	DelayByPeriod //!< Call it again one period after the call ended, the schedule continues from there
+};
+
+/*!
+* \brief What the times of the calls are aligned to
+*/
+enum class LoopingAlignment {
+	None, //!< The first call is at the time of starting or resuming plus the phase
+	SteadyClock, //!< The calls are at multiples of the period plus the phase since the epoch of std::chrono::steady_clock
+	SystemClock //!< The calls are at multiples of the period plus the phase since the epoch of std::chrono::system_clock, like at whole seconds
+};
+
+/*!
+* \brief What happens if joining or destroying a looping thread takes longer than the timeout set by setJoinTimeout()
+*/
+enum class LoopingJoinTimeoutPolicy {
+	Report, //!< Passes an error to the error callback and keeps waiting
+	Terminate //!< Passes an error to the error callback and calls std::terminate()
+};
+
+namespace LoopingDetail {
+
+	/*!
+	* \brief The state of a looping thread and the code running the loop, allocated separately so that its address doesn't change when the looping
+	* thread is moved
+	*/
+	template <typename Routine>
+	class LoopingCore {
+	public:
+		using WakeupPolicy = LoopingWakeupPolicy;
+		using OverrunPolicy = LoopingOverrunPolicy;
+		using Alignment = LoopingAlignment;
+		using JoinTimeoutPolicy = LoopingJoinTimeoutPolicy;
+		using Priority = LoopingPriority;
+
+	private:
+		enum State {
+			Running,
+			Paused,
+			Exiting
+		};
+
+		// The sections are separated by padding instead of alignment, which would need an allocator supporting over-aligned types before C++17
+		char padding0_[LOOPING_THREAD_CACHE_LINE];
+
+		// Read by the worker on every call and written only when the settings change
+		std::atomic<std::chrono::steady_clock::duration> period_;
+		std::atomic<State> state_{Paused};
+		std::atomic<bool> catchUp_{true};
+		std::atomic<OverrunPolicy> overrunPolicy_{OverrunPolicy::RunImmediately};
+		std::atomic<WakeupPolicy> wakeupPolicy_{WakeupPolicy::Sleep};
+		std::atomic<std::chrono::steady_clock::duration> maxLag_{std::chrono::steady_clock::duration::zero()};
+		std::atomic<std::chrono::steady_clock::duration> budget_{std::chrono::steady_clock::duration::zero()};
+		std::atomic<std::chrono::steady_clock::duration> spinMargin_{std::chrono::steady_clock::duration(std::chrono::microseconds(200))};
+		bool active_ = false;
+		LoopingScheduler* scheduler_ = nullptr;
+		Alignment alignment_ = Alignment::None;
+		std::chrono::steady_clock::duration phase_ = std::chrono::steady_clock::duration::zero();
+		std::chrono::steady_clock::duration spread_ = std::chrono::steady_clock::duration::zero();
+		LoopingBackoff backoff_;
+		Routine routine_;
+		std::function<void(const std::exception&)> errorCallback_;
+		std::function<void(uint64_t)> droppedTicksCallback_;
+		std::function<void(std::chrono::steady_clock::duration)> overrunCallback_;
+
+		char padding1_[LOOPING_THREAD_CACHE_LINE];
+
+		// Written by the worker on every call
+		std::chrono::steady_clock::time_point awakenAt_;
+		std::atomic<std::chrono::steady_clock::rep> callStarted_{0};
+		bool continued_ = false;
+		LoopingErrorLimiter errorLimiter_;
+		LoopingStatsRecorder stats_;
+#if defined(LOOPING_THREAD_ARENA)
+		std::vector<unsigned char> arena_;
+		size_t arenaSize_ = 64 * 1024;
+#endif
+
+		char padding2_[LOOPING_THREAD_CACHE_LINE];
+
+		// Written by the threads controlling the loop, notify() can be called very often
+		std::atomic<bool> notified_{false};
+		std::mutex mutex_;
+		std::condition_variable wakeup_;
+		std::condition_variable parkedCondition_;
+		bool parked_ = false;
+		bool resetTimeOnPause_ = true;
+		// The time resume() chose for the next call, taken by the worker because a call may still be running and writing its own time
+		std::atomic<bool> anchorPending_{false};
+		std::chrono::steady_clock::time_point anchor_;
+		// Asynchronous pauses whose calls haven't ended yet
+		unsigned int cancelling_ = 0;
+		bool stopped_ = false;
+		std::vector<std::promise<void>> parkedPromises_;
+
+		char padding3_[LOOPING_THREAD_CACHE_LINE];
+
+		// Rarely used
+		std::chrono::steady_clock::duration joinTimeout_ = std::chrono::steady_clock::duration::zero();
+		JoinTimeoutPolicy joinTimeoutPolicy_ = JoinTimeoutPolicy::Report;
+		LoopingThreadOptions options_;
+		LoopingRegistry* registry_ = nullptr;
+		LoopingWatchdog* watchdog_ = nullptr;
+		LoopingErrorReporter* errorReporter_ = nullptr;
+		std::string errorName_;
+		LoopingScheduler::Task task_;
+		std::thread worker_;
+		LoopingThreadPool::Thread pooled_;
+
+		static inline void relax()
+		{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+			_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+			__asm__ __volatile__("yield");
+#else
+			std::this_thread::yield();
+#endif
+		}
+
+		// The routines called by a scheduler with a manual clock run in its time
+		inline std::chrono::steady_clock::time_point currentTime() const
+		{
+			return scheduler_ ? scheduler_->now() : std::chrono::steady_clock::now();
+		}
+
+		/*!
+		* \brief Returns the time of the first call after starting or resuming, according to the alignment, phase and spread
+		*/
+		inline std::chrono::steady_clock::time_point anchor(std::chrono::steady_clock::time_point now) const
+		{
+			std::chrono::steady_clock::duration offset = phase_;
+			if (spread_ > std::chrono::steady_clock::duration::zero()) {
+				std::minstd_rand generator(std::random_device{}());
+				offset += std::chrono::steady_clock::duration(std::uniform_int_distribution<std::chrono::steady_clock::duration::rep>(0, spread_.count() - 1)(generator));
+			}
+			if (alignment_ == Alignment::None)
+				return now + offset;
+			std::chrono::steady_clock::duration period = period_.load(std::memory_order_relaxed);
+			if (period <= std::chrono::steady_clock::duration::zero())
+				return now;
+
+			std::chrono::steady_clock::duration sinceEpoch = (alignment_ == Alignment::SystemClock)
+					? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::system_clock::now().time_since_epoch())
+					: now.time_since_epoch();
+			std::chrono::steady_clock::duration intoPeriod = (sinceEpoch - offset) % period;
+			if (intoPeriod < std::chrono::steady_clock::duration::zero())
+				intoPeriod += period;
+			return intoPeriod == std::chrono::steady_clock::duration::zero() ? now : now + (period - intoPeriod);
+		}
+
+		// Must be called by the thread calling the routine
+		inline void fail(const std::exception& e)
+		{
+			if (!errorReporter_) {
+				stats_.recordError(false);
+				errorCallback_(e);
+				return;
+			}
+			std::chrono::steady_clock::time_point now = currentTime();
+			bool admitted = errorLimiter_.admit(e.what(), now);
+			stats_.recordError(!admitted);
+			if (admitted)
+				errorReporter_->report(LoopingError{this, errorName_, stats_.runTime().count(), now, e.what(), errorLimiter_.takeSuppressed()});
+		}
+
+		template <typename Callback, typename Argument>
+		inline void callBack(const Callback& callback, Argument argument)
+		{
+			if (callback) {
+				try {
+					callback(argument);
+				} catch(std::exception& e) {
+					fail(e);
+				}
+			}
+		}
+
+		inline void dropTicks(uint64_t dropped)
+		{
+			stats_.recordDropped(dropped);
+			callBack(droppedTicksCallback_, dropped);
+		}
+
+		inline std::chrono::steady_clock::time_point nextAwakening(std::chrono::steady_clock::time_point awakenAt, std::chrono::steady_clock::time_point now,
+				const LoopResult& result, bool early, bool overrun)
+		{
+			std::chrono::steady_clock::duration period = period_.load(std::memory_order_relaxed);
+			switch (result.action) {
+			case LoopResult::RunAgainNow:
+				return now;
+			case LoopResult::Delay:
+				return now + result.delay;
+			case LoopResult::Busy:
+			case LoopResult::Backoff:
+				if (backoff_.enabled()) {
+					period = backoff_.adapt(period, result.action);
+					period_.store(period, std::memory_order_relaxed);
+				}
+				break;
+			case LoopResult::Regular:
+			case LoopResult::Continue:
+				break;
+			}
+
+			// A call caused by notify() doesn't move the regular schedule
+			if (early)
+				return awakenAt;
+			if (!catchUp_.load(std::memory_order_relaxed))
+				return now + period;
+
+			std::chrono::steady_clock::time_point next = awakenAt + period;
+			if (overrun && next <= now) {
+				OverrunPolicy overrunPolicy = overrunPolicy_.load(std::memory_order_relaxed);
+				if (overrunPolicy == OverrunPolicy::DelayByPeriod)
+					return now + period;
+				if (overrunPolicy == OverrunPolicy::SkipToNextSlot) {
+					uint64_t dropped = (now - next) / period + 1;
+					dropTicks(dropped);
+					return next + dropped * period;
+				}
+			}
+			std::chrono::steady_clock::duration maxLag = maxLag_.load(std::memory_order_relaxed);
+			if (maxLag > std::chrono::steady_clock::duration::zero() && period > std::chrono::steady_clock::duration::zero() && now - next > maxLag) {
+				// Skips whole periods to keep the phase, the next call is then the only one that's late
+				// With a maximum lag shorter than the period, the next call may be too late without a whole period to skip
+				uint64_t dropped = (now - next) / period;
+				if (dropped > 0) {
+					next += dropped * period;
+					dropTicks(dropped);
+				}
+			}
+			return next;
+		}
+
+		inline void checkNotStopped() const
+		{
+			if (state_.load(std::memory_order_relaxed) == Exiting)
+				throw std::logic_error("Controlling a looping thread that has been stopped");
+		}
+
+		// Must be called with the mutex locked and without the routine running
+		inline std::chrono::steady_clock::time_point resumeTime()
+		{
+			if (!anchorPending_.load(std::memory_order_relaxed))
+				return awakenAt_;
+			anchorPending_.store(false, std::memory_order_relaxed);
+			return anchor_;
+		}
+
+		// Must be called with the mutex locked
+		inline void fulfilParkedPromises()
+		{
+			for (std::promise<void>& promise : parkedPromises_)
+				promise.set_value();
+			parkedPromises_.clear();
+		}
+
+		/*!
+		* \brief Returns if there is a pending notification to call the routine before its regular time, and consumes it
+		*/
+		inline bool consumeNotification(std::chrono::steady_clock::time_point awakenAt, std::chrono::steady_clock::time_point now)
+		{
+			if (!notified_.load(std::memory_order_relaxed))
+				return false;
+			return notified_.exchange(false, std::memory_order_acquire) && awakenAt > now;
+		}
+
+		inline LoopResult call(LoopingDetail::TickContext& context)
+		{
+#if defined(LOOPING_THREAD_ARENA)
+			if (LoopingDetail::usesArena(routine_)) {
+				if (arena_.size() != arenaSize_)
+					arena_.resize(arenaSize_);
+				// Allocations that don't fit into the buffer go to the default resource and are freed with the rest
+				std::pmr::monotonic_buffer_resource arena(arena_.data(), arena_.size(), std::pmr::get_default_resource());
+				context.arena = &arena;
+				return LoopingDetail::call(routine_, context);
+			}
+#endif
+			return LoopingDetail::call(routine_, context);
+		}
+
+		/*!
+		* \brief Calls the routine once and returns the time of the next call
+		*/
+		inline std::chrono::steady_clock::time_point tick(std::chrono::steady_clock::time_point awakenAt, std::chrono::steady_clock::time_point started)
+		{
+			bool early = consumeNotification(awakenAt, started);
+			LoopingDetail::TickContext context;
+			std::chrono::steady_clock::time_point covered = awakenAt;
+			if (LoopingDetail::usesTick(routine_)) {
+				context.tick.scheduled = awakenAt;
+				context.tick.started = started;
+				context.tick.budget = budget_.load(std::memory_order_relaxed);
+				context.tick.clock = scheduler_ ? scheduler_->manualClock() : nullptr;
+				context.tick.continued = continued_;
+				std::chrono::steady_clock::duration period = period_.load(std::memory_order_relaxed);
+				if (early) {
+					context.tick.elapsed = 0;
+				} else if (catchUp_.load(std::memory_order_relaxed) && period > std::chrono::steady_clock::duration::zero() && started > awakenAt) {
+					// The later periods that have already started are covered by this call too
+					context.tick.elapsed = (started - awakenAt) / period + 1;
+					covered += (context.tick.elapsed - 1) * period;
+				}
+			}
+			LoopResult result;
+			LOOPING_TRACE(this, options_.name.c_str(), RoutineBegin);
+			// The watchdog measures real time even if the routine runs in simulated time
+			callStarted_.store((scheduler_ && scheduler_->manualClock() ? std::chrono::steady_clock::now() : started).time_since_epoch().count(), std::memory_order_release);
+			try {
+				result = call(context);
+			} catch(std::exception& e) {
+				LOOPING_TRACE(this, options_.name.c_str(), Error);
+				fail(e);
+			} catch(...) {
+				LOOPING_TRACE(this, options_.name.c_str(), Error);
+				fail(std::runtime_error("An unknown error has been thrown in a looping thread"));
+			}
+			callStarted_.store(0, std::memory_order_relaxed);
+			continued_ = result.action == LoopResult::Continue;
+			std::chrono::steady_clock::time_point ended = currentTime();
+			LOOPING_TRACE(this, options_.name.c_str(), RoutineEnd);
+			std::chrono::steady_clock::duration period = period_.load(std::memory_order_relaxed);
+			stats_.record(early ? started : awakenAt, started, ended, period);
+			bool overrun = period > std::chrono::steady_clock::duration::zero() && ended - started > period;
+			if (overrun) {
+				stats_.recordOverrun();
+				callBack(overrunCallback_, ended - started);
+			}
+			return nextAwakening(covered, ended, result, early, overrun);
+		}
+
+		inline bool fire(std::chrono::steady_clock::time_point& awakenAt)
+		{
+			awakenAt = awakenAt_ = tick(awakenAt, currentTime());
+			return true;
+		}
+	
+		inline void work()
+		{
+			try {
+				options_.apply();
+			} catch(std::exception& e) {
+				fail(e);
+			}
+
+			while (true) {
+				if (anchorPending_.load(std::memory_order_acquire)) {
+					std::unique_lock<std::mutex> lock(mutex_);
+					awakenAt_ = resumeTime();
+				}
+				// If the routine is due, it's called without touching the mutex
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if (state_.load(std::memory_order_acquire) == Running && (awakenAt_ <= now || notified_.load(std::memory_order_relaxed))) {
+					awakenAt_ = tick(awakenAt_, now);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(mutex_);
+				State state = state_.load(std::memory_order_relaxed);
+				if (state == Exiting)
+					break;
+				if (state == Paused) {
+					parked_ = true;
+					fulfilParkedPromises();
+					parkedCondition_.notify_all();
+					LOOPING_TRACE(this, options_.name.c_str(), WaitStart);
+					wakeup_.wait(lock, [this] { return state_.load(std::memory_order_relaxed) != Paused; });
+					LOOPING_TRACE(this, options_.name.c_str(), Wakeup);
+					parked_ = false;
+				} else {
+					WakeupPolicy wakeupPolicy = wakeupPolicy_.load(std::memory_order_relaxed);
+					std::chrono::steady_clock::time_point sleepUntil = awakenAt_;
+					if (wakeupPolicy == WakeupPolicy::SleepThenSpin)
+						sleepUntil -= spinMargin_.load(std::memory_order_relaxed);
+					else if (wakeupPolicy == WakeupPolicy::Spin)
+						sleepUntil = std::chrono::steady_clock::time_point::min();
+					LOOPING_TRACE(this, options_.name.c_str(), WaitStart);
+					if (wakeup_.wait_until(lock, sleepUntil, [this] {
+						return state_.load(std::memory_order_relaxed) != Running || notified_.load(std::memory_order_relaxed)
+								|| anchorPending_.load(std::memory_order_relaxed);
+					})) {
+						LOOPING_TRACE(this, options_.name.c_str(), Wakeup);
+						continue;
+					}
+					if (wakeupPolicy != WakeupPolicy::Sleep) {
+						lock.unlock();
+						while (state_.load(std::memory_order_acquire) == Running && !notified_.load(std::memory_order_relaxed)
+								&& !anchorPending_.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < awakenAt_)
+							relax();
+					}
+					LOOPING_TRACE(this, options_.name.c_str(), Wakeup);
+				}
+			}
+			markStopped();
+		}
+
+		inline void markStopped()
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				stopped_ = true;
+			}
+			parkedCondition_.notify_all();
+		}
+
+		inline void waitUntilStopped()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (joinTimeout_ == std::chrono::steady_clock::duration::zero() || parkedCondition_.wait_for(lock, joinTimeout_, [this] { return stopped_; }))
+				return;
+			lock.unlock();
+			const char* message = "Timed out waiting for the routine of a looping thread to end";
+			if (errorReporter_)
+				errorReporter_->report(LoopingError{this, errorName_, stats_.runTime().count(), currentTime(), message, 0});
+			else
+				errorCallback_(std::runtime_error(message));
+			if (joinTimeoutPolicy_ == JoinTimeoutPolicy::Terminate)
+				std::terminate();
+		}
+	public:
+
+		inline LoopingCore() : routine_()
+		{
+	
+		}
+	
+		/*!
+		* \brief Constructs the thread and starts running the routine periodically
+		* \param The calling period
+		* \param The function that is called periodically
+		* \param If the thread starts running or is paused until resume() is called
+		*/
+		inline LoopingCore(std::chrono::steady_clock::duration period, Routine routine, bool run = true) :
+			period_(period),
+			active_(true),
+			routine_(std::move(routine)),
+			errorCallback_([](const std::exception& e) { std::cout << e.what() << std::endl; }),
+			worker_(&LoopingCore::work, this)
+		{
+			if (run)
+				resume();
+		}
+
+		/*!
+		* \brief Constructs the thread with given properties and starts running the routine periodically
+		* \param The calling period
+		* \param The function that is called periodically
+		* \param Affinity, scheduling policy and name of the thread, failures to apply them are reported to the error callback
+		* \param If the thread starts running or is paused until resume() is called
+		*/
+		inline LoopingCore(std::chrono::steady_clock::duration period, Routine routine, const LoopingThreadOptions& options, bool run = true) :
+			period_(period),
+			active_(true),
+			routine_(std::move(routine)),
+			errorCallback_([](const std::exception& e) { std::cout << e.what() << std::endl; }),
+			options_(options),
+			worker_(&LoopingCore::work, this)
+		{
+			if (run)
+				resume();
+		}
+
+		/*!
+		* \brief Constructs the thread using a thread from a pool and starts running the routine periodically
+		* \param The pool the thread is taken from and given back to when this object is joined or destroyed, must outlive it
+		* \param The calling period
+		* \param The function that is called periodically
+		* \param If the thread starts running or is paused until resume() is called
+		*/
+		inline LoopingCore(LoopingThreadPool& pool, std::chrono::steady_clock::duration period, Routine routine, bool run = true) :
+			period_(period),
+			active_(true),
+			routine_(std::move(routine)),
+			errorCallback_([](const std::exception& e) { std::cout << e.what() << std::endl; }),
+			pooled_(pool.start([this] { work(); }))
+		{
+			if (run)
+				resume();
+		}
+
+		/*!
+		* \brief Constructs the looping routine without its own thread, the routine is called by the scheduler's threads
+		* \param The scheduler whose threads call the routine, must outlive this object
+		* \param The calling period
+		* \param The function that is called periodically
+		* \param If the routine starts running or is paused until resume() is called
+		*/
+		inline LoopingCore(LoopingScheduler& scheduler, std::chrono::steady_clock::duration period, Routine routine, bool run = true) :
+			period_(period),
+			active_(true),
+			scheduler_(&scheduler),
+			routine_(std::move(routine)),
+			errorCallback_([](const std::exception& e) { std::cout << e.what() << std::endl; }),
+			task_([this] (std::chrono::steady_clock::time_point& awakenAt) { return fire(awakenAt); })
+		{
+			if (run)
+				resume();
+		}
+	
+		/*!
+		* \brief The destructor, interrupts the wait for another routine call, but waits for the routine to end if it's running
+		*/
+		inline ~LoopingCore()
+		{
+			if (registry_)
+				registry_->remove(this);
+			join();
+			if (watchdog_)
+				watchdog_->remove(this);
+		}
+
+		/*!
+		* \brief Tells the routine to stop without waiting for it, it won't be called again and the object can only be joined or destroyed
+		*
+		* \note Stopping many instances first and joining them afterwards makes the shutdown as long as the slowest routine, not their sum
+		*/
+		inline void requestStop()
+		{
+			if (!active_)
+				return;
 			{
-				std::unique_lock<std::timed_mutex> lock(waitMutex_, std::try_to_lock);
-				if (lock.owns_lock())
-					interrupted = true;
-				else {
-					if (awakenAt >= std::chrono::steady_clock::now() && lock.try_lock_until(awakenAt))
-						interrupted = true;
+				std::unique_lock<std::mutex> lock(mutex_);
+				if (state_.load(std::memory_order_relaxed) == Exiting)
+					return;
+				state_.store(Exiting, std::memory_order_release);
+				fulfilParkedPromises();
+			}
+			if (scheduler_)
+				scheduler_->cancelAsync(task_, [this] { markStopped(); });
+			else
+				wakeup_.notify_one();
+		}
+
+		/*!
+		* \brief Stops the routine if it wasn't requested yet and waits until it ends if it's running
+		*
+		* \note If a join timeout is set and exceeded, it's handled according to the policy
+		*/
+		inline void join()
+		{
+			if (!active_)
+				return;
+			requestStop();
+			waitUntilStopped();
+			if (scheduler_)
+				scheduler_->cancel(task_);
+			else if (worker_.joinable())
+				worker_.join();
+			else if (pooled_.joinable())
+				pooled_.join();
+		}
+	
+		/*!
+		* \brief Pause the execution, will wait until the end of routine
+		*/
+		inline void pause(bool resetTime = true)
+		{
+			if (active_) {
+				std::unique_lock<std::mutex> lock(mutex_);
+				checkNotStopped();
+				if (state_.load(std::memory_order_relaxed) != Running) throw std::logic_error("Pausing a looping thread that is already paused");
+				state_.store(Paused, std::memory_order_release);
+				resetTimeOnPause_ = resetTime;
+				LOOPING_TRACE(this, options_.name.c_str(), Pause);
+				if (scheduler_) {
+					lock.unlock();
+					scheduler_->cancel(task_);
+					return;
 				}
-				if (resetTimeOnPause_) {
-					awakenAt = std::chrono::steady_clock::now() + period_;
+				wakeup_.notify_one();
+				parkedCondition_.wait(lock, [this] { return parked_; });
+			}
+		}
+	
+		/*!
+		* \brief Pause the execution without waiting for the end of the routine
+		* \param If the time should be reset, like in pause()
+		* \return A future that becomes ready when the routine is no longer running, or when the execution is resumed before that
+		*/
+		inline std::future<void> pauseAsync(bool resetTime = true)
+		{
+			std::promise<void> parked;
+			std::future<void> result = parked.get_future();
+			if (!active_) {
+				parked.set_value();
+				return result;
+			}
+			std::unique_lock<std::mutex> lock(mutex_);
+			checkNotStopped();
+			if (state_.load(std::memory_order_relaxed) != Running) throw std::logic_error("Pausing a looping thread that is already paused");
+			state_.store(Paused, std::memory_order_release);
+			resetTimeOnPause_ = resetTime;
+			LOOPING_TRACE(this, options_.name.c_str(), Pause);
+			parkedPromises_.push_back(std::move(parked));
+			if (scheduler_) {
+				cancelling_++;
+				lock.unlock();
+				scheduler_->cancelAsync(task_, [this] {
+					std::chrono::steady_clock::time_point at;
+					{
+						std::unique_lock<std::mutex> lock(mutex_);
+						fulfilParkedPromises();
+						// If resumed while the call was running, it's scheduled only now that the call has set the time
+						if (--cancelling_ || state_.load(std::memory_order_relaxed) != Running)
+							return;
+						at = resumeTime();
+					}
+					scheduler_->schedule(task_, at, notified_.load(std::memory_order_relaxed) ? std::min(at, currentTime()) : at);
+				});
+				return result;
+			}
+			// The worker might have never left the previous pause
+			if (parked_)
+				fulfilParkedPromises();
+			lock.unlock();
+			wakeup_.notify_one();
+			return result;
+		}
+
+		/*!
+		* \brief Resume paused execution
+		*/
+		inline void resume()
+		{
+			if (active_) {
+				std::chrono::steady_clock::time_point at;
+				bool schedule = false;
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					checkNotStopped();
+					if (state_.load(std::memory_order_relaxed) != Paused) throw std::logic_error("Resuming a looping thread that is not paused");
+					if (resetTimeOnPause_) {
+						anchor_ = anchor(currentTime());
+						anchorPending_.store(true, std::memory_order_relaxed);
+					}
 					resetTimeOnPause_ = false;
+					fulfilParkedPromises();
+					state_.store(Running, std::memory_order_release);
+					LOOPING_TRACE(this, options_.name.c_str(), Resume);
+					if (scheduler_ && !cancelling_) {
+						at = resumeTime();
+						schedule = true;
+					}
 				}
+				if (schedule)
+					scheduler_->schedule(task_, at, notified_.load(std::memory_order_relaxed) ? std::min(at, currentTime()) : at);
+				else if (!scheduler_)
+					wakeup_.notify_one();
 			}
-			
-			if (interrupted) {
-				if (exiting_) break;
-				pauseLock_.unlock();
-				std::unique_lock<std::mutex> lock(resumeMutex_);
-				pauseLock_.lock();
+		}
+	
+		/*!
+		* \brief Makes the routine run as soon as possible without waiting for its regular time, doesn't wait for it
+		*
+		* Multiple notifications before the routine starts cause only one call. The regular schedule isn't affected. If the routine is running,
+		* it will be called again right after it ends. If paused, it will be called after resuming.
+		*/
+		inline void notify()
+		{
+			if (!active_ || notified_.exchange(true, std::memory_order_release))
+				return;
+			if (scheduler_) {
+				if (state_.load(std::memory_order_acquire) == Running)
+					scheduler_->expedite(task_, currentTime());
 			} else {
-				try {
-					routine_();
-				} catch(std::exception& e) {
-					errorCallback_(e);
-				} catch(...) {
-					errorCallback_(std::runtime_error("An unknown error has been thrown in a looping thread"));
+				// Locking prevents the notification from getting lost between checking the condition and starting to wait
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
 				}
-				if (catchUp_)
-					awakenAt += period_;
-				else
-					awakenAt = std::chrono::steady_clock::now() + period_;
+				wakeup_.notify_one();
 			}
 		}
-	}
+
+		/*!
+		* \brief Changes the period
+		* \param The new calling period
+		*/
+		inline void setPeriod(std::chrono::steady_clock::duration newPeriod)
+		{
+			period_.store(newPeriod, std::memory_order_relaxed);
+		}
+
+
+		/*!
+		* \brief Enables or disables the catch up feature
+		* \param If it should be enabled
+		*
+		* \note Catch up enabled causes the program call the routine only the proper number of times, so if the thread is delayed, the routine
+		* will still be called as many times as expected over a long time
+		*/
+		inline void setCatchUp(bool catchUp)
+		{
+			catchUp_.store(catchUp, std::memory_order_relaxed);
+		}
+
+		/*!
+		* \brief Limits how far behind the schedule catching up may get
+		* \param The maximum lag, zero for unlimited
+		*
+		* \note If the routine is delayed by more than this, the calls it missed are skipped instead of being run back-to-back, except one.
+		* Only affects catch up enabled.
+		*/
+		inline void setMaxLag(std::chrono::steady_clock::duration maxLag)
+		{
+			maxLag_.store(maxLag, std::memory_order_relaxed);
+		}
+
+		/*!
+		* \brief Sets how long a call of the routine should take at most, LoopTick::shouldYield() returns true once it's used up
+		* \param The budget, zero for unlimited, which is the default
+		*
+		* \note The routine isn't interrupted, only routines accepting a const LoopTick& can see the budget and stop at a safe point
+		*/
+		inline void setBudget(std::chrono::steady_clock::duration budget)
+		{
+			budget_.store(budget, std::memory_order_relaxed);
+		}
+
+		/*!
+		* \brief Sets the function that is told how many calls were skipped because of the maximum lag
+		* \param The function, called by the thread calling the routine
+		*/
+		inline void setDroppedTicksCallback(std::function<void(uint64_t)> droppedTicksCallback)
+		{
+			droppedTicksCallback_ = droppedTicksCallback;
+		}
+
+		/*!
+		* \brief Aligns the times of the calls to a clock and shifts them by a phase
+		* \param What the calls are aligned to
+		* \param The phase, for example every second at 250 ms past the second with SystemClock alignment and one second period
+		* \param If nonzero, the phase is increased by a random duration shorter than this, to spread the calls of different instances
+		*
+		* \note Applied when starting and when resuming with time reset, the calls then follow the period, so catch up should be enabled
+		*/
+		inline void setPhase(Alignment alignment, std::chrono::steady_clock::duration phase = std::chrono::steady_clock::duration::zero(),
+				std::chrono::steady_clock::duration spread = std::chrono::steady_clock::duration::zero())
+		{
+			alignment_ = alignment;
+			phase_ = phase;
+			spread_ = spread;
+		}
+
+		/*!
+		* \brief Sets how much later than scheduled the routine may be called, so that the scheduler can call it in one wakeup with others
+		* \param The slack
+		*
+		* \note Only affects routines called by a LoopingScheduler, a thread of its own can use LoopingThreadOptions::timerSlack instead
+		*/
+		inline void setSlack(std::chrono::steady_clock::duration slack)
+		{
+			if (scheduler_)
+				scheduler_->setSlack(task_, slack);
+		}
+
+		/*!
+		* \brief Sets the priority class of the routine, when several routines are due, the scheduler calls those of more important classes first
+		* \param The class, Normal by default
+		*
+		* \note Only affects routines called by a LoopingScheduler, a thread of its own doesn't compete with other routines
+		*/
+		inline void setPriority(Priority priority)
+		{
+			if (scheduler_)
+				scheduler_->setPriority(task_, priority);
+		}
+
+		/*!
+		* \brief Sets what happens when a call of the routine takes longer than the period
+		* \param The policy, RunImmediately by default
+		*
+		* \note Only affects catch up enabled, without it the next call is always one period after the previous one ended
+		*/
+		inline void setOverrunPolicy(OverrunPolicy policy)
+		{
+			overrunPolicy_.store(policy, std::memory_order_relaxed);
+		}
+
+		/*!
+		* \brief Sets the function that is told how long a call that took longer than the period took
+		* \param The function, called by the thread calling the routine
+		*/
+		inline void setOverrunCallback(std::function<void(std::chrono::steady_clock::duration)> overrunCallback)
+		{
+			overrunCallback_ = overrunCallback;
+		}
+
+		/*!
+		* \brief Enables adapting the period to the routine's Busy and Backoff results
+		* \param The shortest period, must not be zero
+		* \param The longest period
+		* \param The period is multiplied by this after a Backoff result
+		* \param The period is shortened by this after a Busy result, zero resets it to the shortest period
+		*
+		* \note Must be called while paused or before the first call, the current period is clamped to the bounds
+		*/
+		inline void setAdaptivePeriod(std::chrono::steady_clock::duration minPeriod, std::chrono::steady_clock::duration maxPeriod, double multiplier = 2,
+				std::chrono::steady_clock::duration step = std::chrono::steady_clock::duration::zero())
+		{
+			backoff_.minPeriod = minPeriod;
+			backoff_.maxPeriod = maxPeriod;
+			backoff_.multiplier = multiplier;
+			backoff_.step = step;
+			if (backoff_.enabled())
+				period_.store(backoff_.adapt(period_.load(std::memory_order_relaxed), LoopResult::Regular), std::memory_order_relaxed);
+		}
+
+		/*!
+		* \brief Sets how the thread waits for the next call
+		* \param The policy
+		* \param How long before the deadline it stops sleeping and starts busy-waiting if the policy is SleepThenSpin
+		*
+		* \note Busy-waiting trades CPU time for lower jitter. It's ignored if the routine is called by a LoopingScheduler.
+		*/
+		inline void setWakeupPolicy(WakeupPolicy policy, std::chrono::steady_clock::duration spinMargin = std::chrono::microseconds(200))
+		{
+			spinMargin_.store(spinMargin, std::memory_order_relaxed);
+			wakeupPolicy_.store(policy, std::memory_order_relaxed);
+		}
+
+#if defined(LOOPING_THREAD_ARENA)
+		/*!
+		* \brief Sets the size of the buffer for the arena given to routines accepting a std::pmr::memory_resource&, 64 KiB by default
+		* \param The size in bytes, allocations exceeding it during one call are passed to the default memory resource
+		*
+		* \note Must be called before starting or while paused
+		*/
+		inline void setArenaSize(size_t bytes)
+		{
+			arenaSize_ = bytes;
+		}
+#endif
+
+		/*!
+		* \brief Returns the statistics of the calls of the routine, can be called from any thread without stopping the routine
+		*
+		* \note It's not an atomic snapshot, values recorded while it's being read may be included only partially
+		*/
+		inline LoopingStats stats() const
+		{
+			return stats_.snapshot();
+		}
+
+		/*!
+		* \brief Registers the loop in a registry exporting its statistics, it's unregistered when destroyed
+		* \param The registry, must outlive this object
+		* \param The name of the loop in the exported statistics
+		*/
+		inline void setRegistry(LoopingRegistry& registry, const std::string& name)
+		{
+			if (registry_)
+				registry_->remove(this);
+			registry_ = &registry;
+			registry.add(this, name, stats_, [this] { return state_.load(std::memory_order_relaxed) != Running; });
+		}
+
+		/*!
+		* \brief Registers the loop in a watchdog that reports calls of the routine that take too long, it's unregistered when destroyed
+		* \param The watchdog, must outlive this object
+		* \param The name of the loop passed to the callback
+		* \param How many periods a call may take before it's reported
+		* \param The function called from the watchdog's thread when a call takes too long, once for every such call
+		*/
+		inline void setWatchdog(LoopingWatchdog& watchdog, const std::string& name, double multiple, std::function<void(const LoopingHang&)> callback)
+		{
+			if (watchdog_)
+				watchdog_->remove(this);
+			watchdog_ = &watchdog;
+			bool ownThread = worker_.joinable() || pooled_.joinable();
+			watchdog.add(this, name, callStarted_, period_, multiple, callback, !ownThread ? std::thread::native_handle_type()
+					: worker_.joinable() ? worker_.native_handle() : pooled_.native_handle(), ownThread);
+		}
+
+		/*!
+		* \brief Sets how long join() and the destructor wait for the routine to end before the policy is applied
+		* \param The timeout, zero to wait without a limit, which is the default
+		* \param What to do when the timeout is exceeded
+		*
+		* \note The error callback may be called from the thread joining this object, the thread can't be detached because it uses the object
+		*/
+		inline void setJoinTimeout(std::chrono::steady_clock::duration timeout, JoinTimeoutPolicy policy = JoinTimeoutPolicy::Report)
+		{
+			joinTimeout_ = timeout;
+			joinTimeoutPolicy_ = policy;
+		}
+
+		/*!
+		* \brief Changes error callback
+		* \param errorCallback function which is called when exception is thrown in routine
+		*/
+		inline void setErrorCallback(std::function<void(const std::exception&)> errorCallback)
+		{
+			errorCallback_ = errorCallback;
+		}
+
+		/*!
+		* \brief Passes the errors to a reporter instead of the error callback, so that the thread calling the routine doesn't wait for their output
+		* \param The reporter, must outlive this object
+		* \param The name of the loop in the reported errors
+		* \param At most this many errors are reported per interval, the rest are counted in the statistics and attached to the next reported one
+		* \param The interval, an error with the same message as the previous reported one isn't reported again within it
+		*
+		* \note Must be called before starting or while paused, like setErrorCallback()
+		*/
+		inline void setErrorReporter(LoopingErrorReporter& reporter, const std::string& name, size_t burst = 10,
+				std::chrono::steady_clock::duration interval = std::chrono::seconds(1))
+		{
+			errorReporter_ = &reporter;
+			errorName_ = name;
+			errorLimiter_.setLimit(burst, interval);
+		}
+	};
+
+} // namespace LoopingDetail
+
+/*!
+* \brief The looping thread with the routine stored inline as the given type, so that it's not allocated separately and its call can be inlined
+*
+* It can be moved, the thread keeps using the same state, which is allocated separately. A default-constructed instance allocates its state only if
+* it's configured, a moved-from instance can only be destroyed or assigned to.
+*
+* \note LoopingThread is the alias that stores the routine as LoopingRoutine, a std::function accepting routines with or without a result
+*/
+template <typename Routine>
+class BasicLoopingThread {
 public:
+	using WakeupPolicy = LoopingWakeupPolicy;
+	using OverrunPolicy = LoopingOverrunPolicy;
+	using Alignment = LoopingAlignment;
+	using JoinTimeoutPolicy = LoopingJoinTimeoutPolicy;
+	using Priority = LoopingPriority;
+
+private:
+	using Core = LoopingDetail::LoopingCore<Routine>;
+	std::unique_ptr<Core> core_;
 
+	// The state of a default-constructed instance that does nothing is allocated only when it's needed
+	inline Core& core()
+	{
+		if (!core_)
+			core_.reset(new Core());
+		return *core_;
+	}
+
+public:
 	/*!
 	* \brief Default contructor, nothing is done if created this way
 	*/
-	
-	inline LoopingThread() : routine_(nullptr)
+	inline BasicLoopingThread()
 	{
-	
+
 	}
-	
+
 	/*!
 	* \brief Constructs the thread and starts running the routine periodically
 	* \param The calling period
 	* \param The function that is called periodically
 	* \param If the thread starts running or is paused until resume() is called
 	*/
-	inline LoopingThread(std::chrono::steady_clock::duration period, std::function<void()> routine, bool run = true) :
-		period_(period),
-		routine_(routine),
-		waitLock_(waitMutex_, std::defer_lock),
-		pauseLock_(pauseMutex_),
-		resumeLock_(resumeMutex_),
-		paused_(true),
-		resetTimeOnPause_(false),
-		worker_(&LoopingThread::work, this),
-		errorCallback_([](const std::exception& e) { std::cout << e.what() << std::endl; })
+	inline BasicLoopingThread(std::chrono::steady_clock::duration period, Routine routine, bool run = true) :
+		core_(new Core(period, std::move(routine), run))
 	{
-		if (run)
-			resume();
+
 	}
-	
+
 	/*!
-	* \brief The destructor, interrupts the wait for another routine call, but waits for the routine to end if it's running
+	* \brief Constructs the thread with given properties and starts running the routine periodically
+	* \param The calling period
+	* \param The function that is called periodically
+	* \param Affinity, scheduling policy and name of the thread, failures to apply them are reported to the error callback
+	* \param If the thread starts running or is paused until resume() is called
 	*/
-	inline ~LoopingThread()
+	inline BasicLoopingThread(std::chrono::steady_clock::duration period, Routine routine, const LoopingThreadOptions& options, bool run = true) :
+		core_(new Core(period, std::move(routine), options, run))
 	{
-		if (routine_) {
-			exiting_ = true;
-			if (paused_)
-				resumeLock_.unlock();
-			else
-				waitLock_.unlock();
-			worker_.join();
-			pauseLock_.unlock();
-		}
+
 	}
-	
+
+	/*!
+	* \brief Constructs the thread using a thread from a pool instead of creating one and starts running the routine periodically
+	* \param The pool the thread is taken from and given back to when this object is joined or destroyed, must outlive this object
+	* \param The calling period
+	* \param The function that is called periodically
+	* \param If the thread starts running or is paused until resume() is called
+	*/
+	inline BasicLoopingThread(LoopingThreadPool& pool, std::chrono::steady_clock::duration period, Routine routine, bool run = true) :
+		core_(new Core(pool, period, std::move(routine), run))
+	{
+
+	}
+
+	/*!
+	* \brief Constructs the looping routine without its own thread, the routine is called by the scheduler's threads
+	* \param The scheduler whose threads call the routine, must outlive this object
+	* \param The calling period
+	* \param The function that is called periodically
+	* \param If the routine starts running or is paused until resume() is called
+	*/
+	inline BasicLoopingThread(LoopingScheduler& scheduler, std::chrono::steady_clock::duration period, Routine routine, bool run = true) :
+		core_(new Core(scheduler, period, std::move(routine), run))
+	{
+
+	}
+
+	BasicLoopingThread(BasicLoopingThread&&) noexcept = default;
+
+	/*!
+	* \brief Stops and joins the routine this object had and takes over the other one's
+	*/
+	BasicLoopingThread& operator=(BasicLoopingThread&&) = default;
+
+	/*!
+	* \brief Tells the routine to stop without waiting for it, it won't be called again and the object can only be joined or destroyed
+	*/
+	inline void requestStop()
+	{
+		if (core_)
+			core_->requestStop();
+	}
+
+	/*!
+	* \brief Stops the routine if it wasn't requested yet and waits until it ends if it's running
+	*/
+	inline void join()
+	{
+		if (core_)
+			core_->join();
+	}
+
 	/*!
 	* \brief Pause the execution, will wait until the end of routine
 	*/
 	inline void pause(bool resetTime = true)
 	{
-		if (routine_) {
-			if (paused_) throw std::logic_error("Pausing a looping thread that is already paused");
-			paused_ = true;
-			waitLock_.unlock();
-			resumeLock_.lock();
-			std::unique_lock<std::mutex> pauseLock(pauseMutex_);
-			resetTimeOnPause_ = resetTime;
-		}
+		if (core_)
+			core_->pause(resetTime);
 	}
-	
+
+	/*!
+	* \brief Pause the execution without waiting for the end of the routine
+	*/
+	inline std::future<void> pauseAsync(bool resetTime = true)
+	{
+		return core().pauseAsync(resetTime);
+	}
+
 	/*!
 	* \brief Resume paused execution
 	*/
 	inline void resume()
 	{
-		if (routine_) {
-			if (!paused_) throw std::logic_error("Resuming a looping thread that is not paused");
-			paused_ = false;
-			waitLock_.lock();
-			resumeLock_.unlock();
-		}
+		if (core_)
+			core_->resume();
 	}
-	
+
+	/*!
+	* \brief Makes the routine run as soon as possible without waiting for its regular time, doesn't wait for it
+	*/
+	inline void notify()
+	{
+		if (core_)
+			core_->notify();
+	}
+
 	/*!
 	* \brief Changes the period
-	* \param The new calling period
 	*/
 	inline void setPeriod(std::chrono::steady_clock::duration newPeriod)
 	{
-		period_ = newPeriod;
+		core().setPeriod(newPeriod);
 	}
 
-
 	/*!
 	* \brief Enables or disables the catch up feature
-	* \param If it should be enabled
-	*
-	* \note Catch up enabled causes the program call the routine only the proper number of times, so if the thread is delayed, the routine
-	* will still be called as many times as expected over a long time
 	*/
 	inline void setCatchUp(bool catchUp)
 	{
-		catchUp_ = catchUp;
+		core().setCatchUp(catchUp);
+	}
+
+	/*!
+	* \brief Limits how far behind the schedule catching up may get
+	*/
+	inline void setMaxLag(std::chrono::steady_clock::duration maxLag)
+	{
+		core().setMaxLag(maxLag);
+	}
+
+	/*!
+	* \brief Sets how long a call of the routine should take at most, LoopTick::shouldYield() returns true once it's used up
+	*/
+	inline void setBudget(std::chrono::steady_clock::duration budget)
+	{
+		core().setBudget(budget);
+	}
+
+	/*!
+	* \brief Sets the function that is told how many calls were skipped because of the maximum lag
+	*/
+	inline void setDroppedTicksCallback(std::function<void(uint64_t)> droppedTicksCallback)
+	{
+		core().setDroppedTicksCallback(droppedTicksCallback);
+	}
+
+	/*!
+	* \brief Aligns the times of the calls to a clock and shifts them by a phase
+	*/
+	inline void setPhase(Alignment alignment, std::chrono::steady_clock::duration phase = std::chrono::steady_clock::duration::zero(),
+			std::chrono::steady_clock::duration spread = std::chrono::steady_clock::duration::zero())
+	{
+		core().setPhase(alignment, phase, spread);
+	}
+
+	/*!
+	* \brief Sets how much later than scheduled the routine may be called, so that the scheduler can call it in one wakeup with others
+	*/
+	inline void setSlack(std::chrono::steady_clock::duration slack)
+	{
+		core().setSlack(slack);
+	}
+
+	/*!
+	* \brief Sets the priority class of the routine, when several routines are due, the scheduler calls those of more important classes first
+	*/
+	inline void setPriority(Priority priority)
+	{
+		core().setPriority(priority);
+	}
+
+	/*!
+	* \brief Sets what happens when a call of the routine takes longer than the period
+	*/
+	inline void setOverrunPolicy(OverrunPolicy policy)
+	{
+		core().setOverrunPolicy(policy);
+	}
+
+	/*!
+	* \brief Sets the function that is told how long a call that took longer than the period took
+	*/
+	inline void setOverrunCallback(std::function<void(std::chrono::steady_clock::duration)> overrunCallback)
+	{
+		core().setOverrunCallback(overrunCallback);
+	}
+
+	/*!
+	* \brief Enables adapting the period to the routine's Busy and Backoff results
+	*/
+	inline void setAdaptivePeriod(std::chrono::steady_clock::duration minPeriod, std::chrono::steady_clock::duration maxPeriod, double multiplier = 2,
+			std::chrono::steady_clock::duration step = std::chrono::steady_clock::duration::zero())
+	{
+		core().setAdaptivePeriod(minPeriod, maxPeriod, multiplier, step);
+	}
+
+	/*!
+	* \brief Sets how the thread waits for the next call
+	*/
+	inline void setWakeupPolicy(WakeupPolicy policy, std::chrono::steady_clock::duration spinMargin = std::chrono::microseconds(200))
+	{
+		core().setWakeupPolicy(policy, spinMargin);
+	}
+
+#if defined(LOOPING_THREAD_ARENA)
+	/*!
+	* \brief Sets the size of the buffer for the arena given to routines accepting a std::pmr::memory_resource&, 64 KiB by default
+	*/
+	inline void setArenaSize(size_t bytes)
+	{
+		core().setArenaSize(bytes);
+	}
+#endif
+
+	/*!
+	* \brief Returns the statistics of the calls of the routine, can be called from any thread without stopping the routine
+	*/
+	inline LoopingStats stats() const
+	{
+		return core_ ? core_->stats() : LoopingStatsRecorder().snapshot();
+	}
+
+	/*!
+	* \brief Registers the loop in a registry exporting its statistics, it's unregistered when destroyed
+	*/
+	inline void setRegistry(LoopingRegistry& registry, const std::string& name)
+	{
+		core().setRegistry(registry, name);
+	}
+
+	/*!
+	* \brief Registers the loop in a watchdog that reports calls of the routine that take too long, it's unregistered when destroyed
+	*/
+	inline void setWatchdog(LoopingWatchdog& watchdog, const std::string& name, double multiple, std::function<void(const LoopingHang&)> callback)
+	{
+		core().setWatchdog(watchdog, name, multiple, callback);
+	}
+
+	/*!
+	* \brief Sets how long join() and the destructor wait for the routine to end before the policy is applied
+	*/
+	inline void setJoinTimeout(std::chrono::steady_clock::duration timeout, JoinTimeoutPolicy policy = JoinTimeoutPolicy::Report)
+	{
+		core().setJoinTimeout(timeout, policy);
 	}
 
 	/*!
 	* \brief Changes error callback
-	* \param errorCallback function which is called when exception is thrown in routine
 	*/
 	inline void setErrorCallback(std::function<void(const std::exception&)> errorCallback)
 	{
-		errorCallback_ = errorCallback;
+		core().setErrorCallback(errorCallback);
+	}
+
+	/*!
+	* \brief Passes the errors to a reporter instead of the error callback, so that the thread calling the routine doesn't wait for their output
+	*/
+	inline void setErrorReporter(LoopingErrorReporter& reporter, const std::string& name, size_t burst = 10,
+			std::chrono::steady_clock::duration interval = std::chrono::seconds(1))
+	{
+		core().setErrorReporter(reporter, name, burst, interval);
 	}
 };
+
+using LoopingThread = BasicLoopingThread<LoopingRoutine>;
 #endif // LOOPING_THREAD_H
@@ -0,0 +1,515 @@
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <ctime>
+#include "looping_thread.hpp"
+#include "looping_thread_group.hpp"
+#include "looping_pipeline.hpp"
+
+// Run without arguments to run all benchmarks, or with the names of the ones to run
+
+using Clock = std::chrono::steady_clock;
+
+static double nanoseconds(Clock::duration duration) {
+	return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+static double microseconds(uint64_t nanoseconds) {
+	return nanoseconds / 1000.0;
+}
+
+// Process CPU time, to see how much the waiting costs and not only how long it takes
+static double cpuNanoseconds() {
+	return double(std::clock()) * 1e9 / CLOCKS_PER_SEC;
+}
+
+// Zero period, so the loop never sleeps and the measured time is the cost of the loop itself
+template <typename Loop, typename Routine>
+static void tickOverhead(Routine routine, std::atomic<uint64_t>& ticks, const char* storage) {
+	Clock::time_point start = Clock::now();
+	{
+		Loop loop(Clock::duration::zero(), routine);
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	Clock::duration elapsed = Clock::now() - start;
+	std::cout << "  " << storage << ": " << nanoseconds(elapsed) / ticks.load() << " ns per iteration (" << ticks.load() << " iterations)" << std::endl;
+}
+
+static void tickOverhead() {
+	std::atomic<uint64_t> ticks(0);
+	auto routine = [&] {
+		ticks.fetch_add(1, std::memory_order_relaxed);
+	};
+	tickOverhead<LoopingThread>(routine, ticks, "std::function");
+	ticks = 0;
+	tickOverhead<BasicLoopingThread<decltype(routine)>>(routine, ticks, "inline");
+}
+
+// CPU time spent per call at realistic periods, includes going to sleep and waking up
+static void periodOverhead() {
+	for (Clock::duration period : { Clock::duration(std::chrono::microseconds(10)), Clock::duration(std::chrono::microseconds(100)),
+			Clock::duration(std::chrono::milliseconds(1)), Clock::duration(std::chrono::milliseconds(10)) }) {
+		std::atomic<uint64_t> ticks(0);
+		double cpuStart = cpuNanoseconds();
+		{
+			LoopingThread loop(period, [&] {
+				ticks.fetch_add(1, std::memory_order_relaxed);
+			});
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+		double cpu = cpuNanoseconds() - cpuStart;
+		std::cout << "  " << nanoseconds(period) / 1000 << " us period: " << cpu / ticks.load() / 1000 << " us CPU per call (" << ticks.load() << " calls)"
+				<< std::endl;
+	}
+}
+
+static void printDistribution(const char* name, const LoopingHistogram& histogram) {
+	std::cout << "  " << name << ": p50 " << microseconds(histogram.percentile(0.5)) << " us, p90 " << microseconds(histogram.percentile(0.9))
+			<< " us, p99 " << microseconds(histogram.percentile(0.99)) << " us, p99.9 " << microseconds(histogram.percentile(0.999))
+			<< " us, max " << microseconds(histogram.max()) << " us (" << histogram.count() << " calls)" << std::endl;
+}
+
+// How late the routine is called compared to the scheduled times
+static void jitter() {
+	struct Policy {
+		LoopingThread::WakeupPolicy policy;
+		const char* name;
+	};
+	for (Clock::duration period : { Clock::duration(std::chrono::microseconds(100)), Clock::duration(std::chrono::milliseconds(1)) }) {
+		std::cout << "  " << nanoseconds(period) / 1000 << " us period" << std::endl;
+		for (Policy policy : { Policy{ LoopingThread::WakeupPolicy::Sleep, "sleep" }, Policy{ LoopingThread::WakeupPolicy::SleepThenSpin, "sleep then spin" },
+				Policy{ LoopingThread::WakeupPolicy::Spin, "spin" } }) {
+			LoopingHistogram lateness;
+			uint64_t ticks = 0;
+			Clock::time_point first;
+			{
+				LoopingThread loop(period, [&] {
+					Clock::time_point now = Clock::now();
+					if (ticks == 0)
+						first = now;
+					Clock::duration late = now - (first + ticks * period);
+					lateness.record(late > Clock::duration::zero() ? uint64_t(nanoseconds(late)) : 0);
+					ticks++;
+				}, false);
+				loop.setWakeupPolicy(policy.policy);
+				loop.resume();
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+			}
+			std::cout << "  ";
+			printDistribution(policy.name, lateness);
+		}
+	}
+}
+
+template <typename MakeLoop>
+static void pauseResume(MakeLoop makeLoop, const char* mode) {
+	std::unique_ptr<LoopingThread> loop(makeLoop());
+	LoopingHistogram latency;
+	for (int i = 0; i < 1000; i++) {
+		Clock::time_point start = Clock::now();
+		loop->pause(false);
+		loop->resume();
+		latency.record(uint64_t(nanoseconds(Clock::now() - start)));
+	}
+	printDistribution(mode, latency);
+}
+
+// Round trip of pause() and resume() while the loop is waiting for a distant call
+static void pauseResume() {
+	pauseResume([] { return new LoopingThread(std::chrono::seconds(10), [] {}); }, "own thread");
+	LoopingScheduler scheduler(1);
+	pauseResume([&] { return new LoopingThread(scheduler, std::chrono::seconds(10), [] {}); }, "scheduler");
+}
+
+template <typename MakeLoop>
+static void destruction(MakeLoop makeLoop, const char* mode) {
+	LoopingHistogram latency;
+	for (int i = 0; i < 100; i++) {
+		std::unique_ptr<LoopingThread> loop(makeLoop());
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		Clock::time_point start = Clock::now();
+		loop.reset();
+		latency.record(uint64_t(nanoseconds(Clock::now() - start)));
+	}
+	printDistribution(mode, latency);
+}
+
+// How long the destructor takes while the loop is waiting for a distant call
+static void destruction() {
+	destruction([] { return new LoopingThread(std::chrono::seconds(10), [] {}); }, "own thread");
+	LoopingScheduler scheduler(1);
+	destruction([&] { return new LoopingThread(scheduler, std::chrono::seconds(10), [] {}); }, "scheduler");
+}
+
+template <typename MakeLoop>
+static void scaling(int count, MakeLoop makeLoop, const char* mode) {
+	std::vector<std::unique_ptr<LoopingThread>> loops;
+	double cpuStart = cpuNanoseconds();
+	for (int i = 0; i < count; i++)
+		loops.emplace_back(makeLoop());
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	uint64_t calls = 0;
+	uint64_t lateness = 0;
+	for (std::unique_ptr<LoopingThread>& loop : loops) {
+		LoopingStats stats = loop->stats();
+		calls += stats.count;
+		lateness += stats.count * stats.lateness.mean.count();
+	}
+	loops.clear();
+	double cpu = cpuNanoseconds() - cpuStart;
+	std::cout << "  " << std::setw(5) << count << " loops, " << mode << ": " << cpu / calls / 1000 << " us CPU per call, mean lateness "
+			<< microseconds(calls ? lateness / calls : 0) << " us (" << calls << " calls)" << std::endl;
+}
+
+// Many loops with 10 ms period, each with its own thread or all sharing a scheduler
+static void scaling() {
+	for (int count : { 1, 10, 100, 1000 }) {
+		scaling(count, [] { return new LoopingThread(std::chrono::milliseconds(10), [] {}); }, "own threads");
+		LoopingScheduler scheduler;
+		scaling(count, [&] { return new LoopingThread(scheduler, std::chrono::milliseconds(10), [] {}); }, "scheduler");
+	}
+}
+
+// Wakeups of a scheduler with many loops at random phases, with and without slack
+static void slack() {
+	for (Clock::duration slack : { Clock::duration::zero(), Clock::duration(std::chrono::milliseconds(1)), Clock::duration(std::chrono::milliseconds(5)) }) {
+		LoopingScheduler scheduler(1);
+		std::vector<std::unique_ptr<LoopingThread>> loops;
+		for (int i = 0; i < 200; i++) {
+			loops.emplace_back(new LoopingThread(scheduler, std::chrono::milliseconds(10), [] {}, false));
+			loops.back()->setPhase(LoopingThread::Alignment::None, Clock::duration::zero(), std::chrono::milliseconds(10));
+			loops.back()->setSlack(slack);
+			loops.back()->resume();
+		}
+		uint64_t wakeupsBefore = scheduler.wakeups();
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		uint64_t wakeups = scheduler.wakeups() - wakeupsBefore;
+		uint64_t lateness = 0;
+		uint64_t calls = 0;
+		for (std::unique_ptr<LoopingThread>& loop : loops) {
+			LoopingStats stats = loop->stats();
+			calls += stats.count;
+			lateness += stats.count * stats.lateness.mean.count();
+		}
+		loops.clear();
+		std::cout << "  200 loops, " << nanoseconds(slack) / 1000 << " us slack: " << wakeups << " wakeups per second, mean lateness "
+				<< microseconds(calls ? lateness / calls : 0) << " us" << std::endl;
+	}
+}
+
+// Cost of a tick while another thread keeps notifying the loop or reading its statistics, compile with -DLOOPING_THREAD_CACHE_LINE=1 to compare
+// with the members packed together
+static void control() {
+	for (int operation = 0; operation < 3; operation++) {
+		std::atomic<uint64_t> ticks(0);
+		std::atomic<bool> stop(false);
+		uint64_t operations = 0;
+		Clock::time_point start = Clock::now();
+		{
+			LoopingThread loop(Clock::duration::zero(), [&] {
+				ticks.fetch_add(1, std::memory_order_relaxed);
+			});
+			std::thread controller([&] {
+				while (!stop.load(std::memory_order_relaxed)) {
+					if (operation == 1)
+						loop.notify();
+					else if (operation == 2)
+						operations += loop.stats().count > 0;
+					else
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					operations++;
+				}
+			});
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+			stop = true;
+			controller.join();
+		}
+		const char* names[] = { "idle controller", "notify()", "stats()" };
+		std::cout << "  " << names[operation] << ": " << nanoseconds(Clock::now() - start) / ticks.load() << " ns per tick (" << operations
+				<< " operations), cache line " << LOOPING_THREAD_CACHE_LINE << std::endl;
+	}
+}
+
+// Lateness of fast loops sharing a scheduler with some slow ones, and the cost per call, with per-worker or shared queues
+static void queues() {
+	struct Mode {
+		LoopingScheduler::Queues queues;
+		const char* name;
+	};
+	for (Mode mode : { Mode{ LoopingScheduler::Queues::Shared, "shared queue" }, Mode{ LoopingScheduler::Queues::PerWorker, "per-worker queues" } }) {
+		LoopingScheduler scheduler(4, mode.queues);
+		std::vector<std::unique_ptr<LoopingThread>> loops;
+		double cpuStart = cpuNanoseconds();
+		for (int i = 0; i < 400; i++) {
+			// Every fiftieth routine takes 2 ms
+			if (i % 50 == 0)
+				loops.emplace_back(new LoopingThread(scheduler, std::chrono::milliseconds(10), [] { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }));
+			else
+				loops.emplace_back(new LoopingThread(scheduler, std::chrono::milliseconds(1), [] {}));
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		LoopingHistogram lateness;
+		uint64_t calls = 0;
+		for (int i = 0; i < int(loops.size()); i++) {
+			LoopingStats stats = loops[i]->stats();
+			calls += stats.count;
+			if (i % 50 != 0)
+				lateness.record(stats.lateness.p99.count());
+		}
+		loops.clear();
+		double cpu = cpuNanoseconds() - cpuStart;
+		std::cout << "  " << mode.name << ": " << cpu / calls / 1000 << " us CPU per call, mean p99 lateness of fast loops " << microseconds(lateness.mean())
+				<< " us, worst " << microseconds(lateness.max()) << " us (" << calls << " calls)" << std::endl;
+	}
+}
+
+// Lateness of a heartbeat in an overloaded scheduler, with the same priority as the other loops or a more important one
+static void priority() {
+	for (bool prioritised : { false, true }) {
+		LoopingScheduler scheduler(1);
+		std::vector<std::unique_ptr<LoopingThread>> loops;
+		for (int i = 0; i < 20; i++) {
+			// Together they need twice the time there is
+			loops.emplace_back(new LoopingThread(scheduler, std::chrono::milliseconds(1), [] {
+				Clock::time_point end = Clock::now() + std::chrono::microseconds(100);
+				while (Clock::now() < end) {}
+			}, false));
+			loops.back()->setPriority(LoopingPriority::Low);
+			loops.back()->resume();
+		}
+		LoopingThread heartbeat(scheduler, std::chrono::milliseconds(1), [] {}, false);
+		heartbeat.setPriority(prioritised ? LoopingPriority::Critical : LoopingPriority::Low);
+		heartbeat.resume();
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		LoopingStats::Distribution lateness = heartbeat.stats().lateness;
+		heartbeat.join();
+		loops.clear();
+		std::cout << "  heartbeat " << (prioritised ? "critical" : "low") << ": mean " << microseconds(lateness.mean.count()) << " us, p99 "
+				<< microseconds(lateness.p99.count()) << " us, low class p99 " << microseconds(scheduler.lateness(LoopingPriority::Low).p99.count()) << " us"
+				<< std::endl;
+	}
+}
+
+#if defined(LOOPING_THREAD_ARENA)
+// Cost of a tick that builds a small temporary vector of strings, allocated normally or from the arena, requires C++17
+static void arena() {
+	for (bool useArena : { false, true }) {
+		std::atomic<uint64_t> ticks(0);
+		Clock::time_point start = Clock::now();
+		{
+			LoopingThread loop(Clock::duration::zero(), [&] (std::pmr::memory_resource& arena) {
+				std::pmr::vector<std::pmr::string> scratch(useArena ? &arena : std::pmr::new_delete_resource());
+				for (int i = 0; i < 16; i++)
+					scratch.emplace_back("a string too long for small string optimisation");
+				ticks.fetch_add(1, std::memory_order_relaxed);
+			});
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+		std::cout << "  " << (useArena ? "arena" : "new and delete") << ": " << nanoseconds(Clock::now() - start) / ticks.load() << " ns per iteration" << std::endl;
+	}
+}
+#endif
+
+// Destroying many loops whose routines are running, one by one or stopping all of them first
+static void shutdown() {
+	for (bool grouped : { false, true }) {
+		std::vector<std::unique_ptr<LoopingThread>> loops;
+		for (int i = 0; i < 100; i++)
+			loops.emplace_back(new LoopingThread(std::chrono::milliseconds(1), [] { std::this_thread::sleep_for(std::chrono::milliseconds(5)); }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		Clock::time_point start = Clock::now();
+		if (grouped) {
+			LoopingThreadGroup group;
+			for (std::unique_ptr<LoopingThread>& loop : loops)
+				group.add(*loop);
+			group.join();
+		}
+		loops.clear();
+		std::cout << "  100 loops, " << (grouped ? "group" : "one by one") << ": " << nanoseconds(Clock::now() - start) / 1e6 << " ms" << std::endl;
+	}
+}
+
+// Creating and destroying short-lived loops, with threads created for each of them or taken from a pool
+static void creation() {
+	LoopingThreadPool pool;
+	for (bool pooled : { false, true }) {
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < 1000; i++) {
+			LoopingThread loop = pooled ? LoopingThread(pool, std::chrono::milliseconds(10), [] {}) : LoopingThread(std::chrono::milliseconds(10), [] {});
+		}
+		std::cout << "  " << (pooled ? "pool" : "own threads") << ": " << nanoseconds(Clock::now() - start) / 1000 / 1000 << " us per loop" << std::endl;
+	}
+}
+
+// Lateness of a 1 ms loop sharing a scheduler thread with a scan that takes 20 ms, which runs all at once or yields when its budget runs out
+static void budget() {
+	for (bool budgeted : { false, true }) {
+		LoopingScheduler scheduler(1);
+		int position = 0;
+		LoopingThread scan(scheduler, std::chrono::milliseconds(2), [&] (const LoopTick& tick) -> LoopResult {
+			if (!tick.continued)
+				position = 0;
+			for (; position < 20000; position++) {
+				if (tick.shouldYield())
+					return LoopResult::Continue;
+				Clock::time_point end = Clock::now() + std::chrono::microseconds(1);
+				while (Clock::now() < end) {}
+			}
+			return LoopResult::Regular;
+		}, false);
+		scan.setBudget(budgeted ? Clock::duration(std::chrono::microseconds(300)) : Clock::duration::zero());
+		scan.resume();
+		LoopingThread beat(scheduler, std::chrono::milliseconds(1), [] {});
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		scan.join();
+		LoopingStats::Distribution lateness = beat.stats().lateness;
+		beat.join();
+		std::cout << "  " << (budgeted ? "300 us budget" : "no budget") << ": lateness of the 1 ms loop p99 " << microseconds(lateness.p99.count())
+				<< " us, worst " << microseconds(lateness.max.count()) << " us" << std::endl;
+	}
+}
+
+// Run time of 20 loops that throw on every call, with each error written to std::cerr by the error callback or given to a reporter that writes them
+// there, redirecting std::cerr to a file or /dev/null keeps them from flooding the terminal
+static void errors() {
+	for (bool reported : { false, true }) {
+		LoopingErrorReporter reporter;
+		std::vector<LoopingThread> loops;
+		for (int i = 0; i < 20; i++) {
+			loops.emplace_back(std::chrono::milliseconds(1), [] { throw std::runtime_error("storage unavailable"); }, false);
+			if (reported)
+				loops.back().setErrorReporter(reporter, "loop " + std::to_string(i));
+			else
+				loops.back().setErrorCallback([] (const std::exception& error) { std::cerr << error.what() << std::endl; });
+			loops.back().resume();
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		uint64_t errors = 0;
+		uint64_t suppressed = 0;
+		Clock::duration worstP99 = Clock::duration::zero();
+		for (LoopingThread& loop : loops) {
+			LoopingStats stats = loop.stats();
+			errors += stats.errors;
+			suppressed += stats.suppressedErrors;
+			worstP99 = std::max(worstP99, Clock::duration(stats.runTime.p99));
+		}
+		loops.clear();
+		std::cout << "  " << (reported ? "reporter" : "callback") << ": worst p99 run time " << nanoseconds(worstP99) / 1000 << " us, " << errors
+				<< " errors, " << suppressed << " left out" << std::endl;
+	}
+}
+
+// Moving elements through three stages connected by rings, woken by the rings with long periods or polling the rings every millisecond
+static void pipeline() {
+	for (bool connected : { true, false }) {
+		const int elements = 200000;
+		LoopingRing<int> first(1024);
+		LoopingRing<int> second(1024);
+		std::atomic<bool> done(false);
+		Clock::duration period = connected ? Clock::duration(std::chrono::seconds(1)) : Clock::duration(std::chrono::milliseconds(1));
+		int produced = 0;
+		LoopingThread source(period, [&] {
+			while (produced < elements && first.push(produced))
+				produced++;
+		}, false);
+		LoopingThread middle(period, [&] {
+			int element = 0;
+			while (!second.full() && first.pop(element))
+				second.push(element);
+		}, false);
+		int consumed = 0;
+		LoopingThread sink(period, [&] {
+			int element = 0;
+			while (second.pop(element))
+				consumed++;
+			if (consumed == elements)
+				done.store(true, std::memory_order_release);
+		}, false);
+		if (connected) {
+			first.connect(source, middle);
+			second.connect(middle, sink);
+		}
+		Clock::time_point start = Clock::now();
+		sink.resume();
+		middle.resume();
+		source.resume();
+		while (!done.load(std::memory_order_acquire))
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		Clock::duration duration = Clock::now() - start;
+		std::cout << "  " << (connected ? "woken by the rings, 1 s periods" : "polling, 1 ms periods") << ": " << elements << " elements in "
+				<< nanoseconds(duration) / 1e6 << " ms, " << nanoseconds(duration) / elements << " ns per element" << std::endl;
+	}
+}
+
+// Ten hours of three loops in simulated time, run twice to check that the calls come in the same order
+static void simulation() {
+	std::string orders[2];
+	for (std::string& order : orders) {
+		Clock::time_point start = Clock::now();
+		LoopingManualClock clock;
+		LoopingScheduler scheduler(clock);
+		int fastCalls = 0;
+		int slowCalls = 0;
+		LoopingThread fast(scheduler, std::chrono::seconds(1), [&] {
+			if (++fastCalls % 1000 == 0)
+				order += 'f';
+		});
+		LoopingThread slow(scheduler, std::chrono::minutes(1), [&] () -> LoopResult {
+			order += 's';
+			// Every seventh call postpones the next one
+			return ++slowCalls % 7 == 0 ? LoopResult(std::chrono::seconds(30)) : LoopResult();
+		});
+		LoopingThread budgeted(scheduler, std::chrono::milliseconds(100), [&] (const LoopTick& tick) {
+			if (tick.shouldYield())
+				order += 'y';
+		});
+		budgeted.setBudget(std::chrono::microseconds(1));
+		uint64_t calls = scheduler.runFor(std::chrono::hours(10));
+		std::cout << "  " << calls << " calls in " << nanoseconds(Clock::now() - start) / 1e6 << " ms" << std::endl;
+	}
+	std::cout << "  same order in both runs: " << (orders[0] == orders[1] ? "yes" : "no") << std::endl;
+}
+
+int main(int argc, char** argv) {
+	struct Benchmark {
+		const char* name;
+		void (*run)();
+	};
+	Benchmark benchmarks[] = {
+		{ "overhead", tickOverhead },
+		{ "period", periodOverhead },
+		{ "jitter", jitter },
+		{ "pause", pauseResume },
+		{ "destruction", destruction },
+		{ "scaling", scaling },
+		{ "slack", slack },
+		{ "queues", queues },
+		{ "priority", priority },
+		{ "control", control },
+#if defined(LOOPING_THREAD_ARENA)
+		{ "arena", arena },
+#endif
+		{ "shutdown", shutdown },
+		{ "creation", creation },
+		{ "pipeline", pipeline },
+		{ "budget", budget },
+		{ "errors", errors },
+		{ "simulation", simulation }
+	};
+	for (const Benchmark& benchmark : benchmarks) {
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; i++)
+			if (benchmark.name == std::string(argv[i]))
+				selected = true;
+		if (!selected)
+			continue;
+		std::cout << benchmark.name << std::endl;
+		benchmark.run();
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+* \brief Class for stopping many looping threads at once
+*
+* Destroying looping threads one after another takes as long as all their running routines together, because each destructor waits for its routine.
+* The group tells all its members to stop first and then waits for them, which takes only as long as the slowest routine.
+*
+* \note The group doesn't own its members, they must not be destroyed or moved before the group is joined or destroyed
+*/
+
+#ifndef LOOPING_THREAD_GROUP_H
+#define LOOPING_THREAD_GROUP_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include "looping_thread.hpp"
+#if defined(__cpp_lib_jthread)
+#include <stop_token>
+#endif
+
+class LoopingThreadGroup {
+	struct Member {
+		void* object;
+		void (*requestStop)(void*);
+		void (*join)(void*);
+	};
+
+	std::vector<Member> members_;
+#if defined(__cpp_lib_jthread)
+	std::unique_ptr<std::stop_callback<std::function<void()>>> stopCallback_;
+#endif
+
+	template <typename Loop>
+	static inline void requestStop(void* loop)
+	{
+		static_cast<Loop*>(loop)->requestStop();
+	}
+
+	template <typename Loop>
+	static inline void join(void* loop)
+	{
+		static_cast<Loop*>(loop)->join();
+	}
+
+public:
+	inline LoopingThreadGroup()
+	{
+
+	}
+
+	LoopingThreadGroup(const LoopingThreadGroup&) = delete;
+	LoopingThreadGroup& operator=(const LoopingThreadGroup&) = delete;
+
+	/*!
+	* \brief The destructor, stops and joins all members
+	*/
+	inline ~LoopingThreadGroup()
+	{
+		join();
+	}
+
+	/*!
+	* \brief Adds a member
+	* \param A looping thread or anything else with requestStop() and join() methods
+	*/
+	template <typename Loop>
+	inline void add(Loop& loop)
+	{
+		members_.push_back(Member{&loop, &LoopingThreadGroup::requestStop<Loop>, &LoopingThreadGroup::join<Loop>});
+	}
+
+	/*!
+	* \brief Tells all members to stop without waiting for them
+	*/
+	inline void requestStop()
+	{
+		for (const Member& member : members_)
+			member.requestStop(member.object);
+	}
+
+	/*!
+	* \brief Tells all members to stop, waits for all of them and removes them, so they may be destroyed afterwards
+	*/
+	inline void join()
+	{
+#if defined(__cpp_lib_jthread)
+		// Waits if the callback is running, it must not use the members after they are removed
+		stopCallback_.reset();
+#endif
+		requestStop();
+		for (const Member& member : members_)
+			member.join(member.object);
+		members_.clear();
+	}
+
+	/*!
+	* \brief Returns the number of members
+	*/
+	inline size_t size() const
+	{
+		return members_.size();
+	}
+
+#if defined(__cpp_lib_jthread)
+	/*!
+	* \brief Makes all members stop when a stop is requested through the token, like when the owning std::jthread is being destroyed
+	* \param The token
+	*
+	* \note If the stop was already requested, they are told to stop immediately. Joining them is still up to the owner of the group.
+	*/
+	inline void stopOn(std::stop_token token)
+	{
+		stopCallback_.reset(new std::stop_callback<std::function<void()>>(token, std::function<void()>([this] { requestStop(); })));
+	}
+#endif
+};
+#endif // LOOPING_THREAD_GROUP_H
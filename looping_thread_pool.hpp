@@ -0,0 +1,213 @@
+/*
+* \brief Class for reusing the threads of looping threads that have been destroyed
+*
+* Each looping thread constructed with a reference to a pool still has a thread of its own while it exists, but the thread is taken from the pool
+* instead of being created, and it's given back to the pool when the looping thread is joined or destroyed. Creating and destroying short-lived
+* loops then doesn't create and destroy operating system threads.
+*
+* \note The pool must outlive all looping threads using it, a thread keeps the name, affinity and other properties set by previous routines
+*/
+
+#ifndef LOOPING_THREAD_POOL_H
+#define LOOPING_THREAD_POOL_H
+
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+class LoopingThreadPool {
+	struct Slot {
+		std::function<void()> job;
+		bool finished = false;
+		bool exiting = false;
+		std::condition_variable condition;
+		std::thread thread;
+	};
+
+	std::mutex mutex_;
+	std::vector<std::unique_ptr<Slot>> idle_;
+	size_t maxIdle_;
+	uint64_t created_ = 0;
+
+	inline void serve(Slot* slot)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true) {
+			slot->condition.wait(lock, [slot] { return slot->job || slot->exiting; });
+			if (!slot->job)
+				return;
+			std::function<void()> job;
+			std::swap(job, slot->job);
+			lock.unlock();
+			job();
+			// The captures are destroyed before the thread is given back
+			job = nullptr;
+			lock.lock();
+			slot->finished = true;
+			slot->condition.notify_all();
+		}
+	}
+
+	inline std::unique_ptr<Slot> create()
+	{
+		std::unique_ptr<Slot> slot(new Slot);
+		slot->thread = std::thread(&LoopingThreadPool::serve, this, slot.get());
+		std::unique_lock<std::mutex> lock(mutex_);
+		created_++;
+		return slot;
+	}
+
+	// Must be called with the mutex locked, the slot must be finished
+	inline void retire(std::unique_lock<std::mutex>& lock, std::unique_ptr<Slot> slot)
+	{
+		slot->exiting = true;
+		slot->condition.notify_all();
+		lock.unlock();
+		slot->thread.join();
+		lock.lock();
+	}
+
+	// Waits until the function running in the thread ends and takes the thread back
+	inline void finish(std::unique_ptr<Slot> slot)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		slot->condition.wait(lock, [&slot] { return slot->finished; });
+		if (idle_.size() < maxIdle_)
+			idle_.push_back(std::move(slot));
+		else
+			retire(lock, std::move(slot));
+	}
+
+public:
+	/*!
+	* \brief A thread taken from the pool, it's given back when joined
+	*/
+	class Thread {
+		friend class LoopingThreadPool;
+		LoopingThreadPool* pool_ = nullptr;
+		std::unique_ptr<Slot> slot_;
+
+		inline Thread(LoopingThreadPool* pool, std::unique_ptr<Slot> slot) : pool_(pool), slot_(std::move(slot))
+		{
+
+		}
+
+	public:
+		inline Thread()
+		{
+
+		}
+
+		/*!
+		* \brief Returns if it has a thread that hasn't been joined
+		*/
+		inline bool joinable() const
+		{
+			return bool(slot_);
+		}
+
+		/*!
+		* \brief Waits until the function ends and gives the thread back to the pool
+		*/
+		inline void join()
+		{
+			pool_->finish(std::move(slot_));
+		}
+
+		inline std::thread::native_handle_type native_handle()
+		{
+			return slot_->thread.native_handle();
+		}
+	};
+
+	/*!
+	* \brief Constructs the pool without starting any threads
+	* \param How many unused threads are kept, additional threads given back are ended
+	*/
+	inline explicit LoopingThreadPool(size_t maxIdle = 64) : maxIdle_(maxIdle)
+	{
+
+	}
+
+	LoopingThreadPool(const LoopingThreadPool&) = delete;
+	LoopingThreadPool& operator=(const LoopingThreadPool&) = delete;
+
+	/*!
+	* \brief The destructor, ends the unused threads
+	*/
+	inline ~LoopingThreadPool()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!idle_.empty()) {
+			std::unique_ptr<Slot> slot = std::move(idle_.back());
+			idle_.pop_back();
+			retire(lock, std::move(slot));
+		}
+	}
+
+	/*!
+	* \brief Starts threads in advance, so that the first loops don't have to
+	* \param The number of unused threads there should be, at most the maximum
+	*/
+	inline void reserve(size_t threads)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (idle_.size() < std::min(threads, maxIdle_)) {
+			lock.unlock();
+			std::unique_ptr<Slot> slot = create();
+			lock.lock();
+			idle_.push_back(std::move(slot));
+		}
+	}
+
+	/*!
+	* \brief Runs a function in an unused thread, or in a new thread if there is none
+	* \param The function
+	* \return The thread, it must be joined before the pool is destroyed
+	*/
+	inline Thread start(std::function<void()> job)
+	{
+		std::unique_ptr<Slot> slot;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (!idle_.empty()) {
+				slot = std::move(idle_.back());
+				idle_.pop_back();
+			}
+		}
+		if (!slot)
+			slot = create();
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			slot->job = std::move(job);
+			slot->finished = false;
+		}
+		slot->condition.notify_all();
+		return Thread(this, std::move(slot));
+	}
+
+	/*!
+	* \brief Returns the number of unused threads
+	*/
+	inline size_t idle()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		return idle_.size();
+	}
+
+	/*!
+	* \brief Returns how many threads the pool has created since it was constructed
+	*/
+	inline uint64_t created()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		return created_;
+	}
+};
+#endif // LOOPING_THREAD_POOL_H
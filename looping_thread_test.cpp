@@ -18,7 +18,64 @@ int main() {
 		std::cout << "(main) Unpaused" << std::endl;
 		std::this_thread::sleep_for(std::chrono::milliseconds(4300));
 		std::cout << "(main) Waited for 4.3s" << std::endl;
+		LoopingStats stats = loop.stats();
+		std::cout << "(main) " << stats.count << " calls, mean lateness " << stats.lateness.mean.count() / 1000 << " us, mean run time "
+				<< stats.runTime.mean.count() / 1000000 << " ms" << std::endl;
 	}
 	std::cout << "(main) Destroyed successfully" << std::endl;
+	{
+		LoopingScheduler scheduler(2);
+		LoopingThread first(scheduler, std::chrono::milliseconds(500), [] {
+			std::cout << "(scheduler) First routine" << std::endl;
+		});
+		LoopingThread second(scheduler, std::chrono::milliseconds(700), [] {
+			std::cout << "(scheduler) Second routine" << std::endl;
+		});
+		std::cout << "(main) Waiting for 1.2s" << std::endl;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+		std::cout << "(main) Pausing the first routine for 0.6s" << std::endl;
+		first.pause();
+		std::this_thread::sleep_for(std::chrono::milliseconds(600));
+		first.resume();
+		std::cout << "(main) Unpaused" << std::endl;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+	}
+	std::cout << "(main) Scheduler destroyed successfully" << std::endl;
+	{
+		LoopingScheduler scheduler(1);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool regular = true;
+		LoopingThread loop(scheduler, std::chrono::milliseconds(100), [start, &regular] (const LoopTick& tick) {
+			int64_t scheduled = std::chrono::duration_cast<std::chrono::milliseconds>(tick.scheduled - start).count();
+			std::cout << "(scheduler) Routine scheduled at " << scheduled << " ms" << (tick.elapsed ? "" : ", notified") << std::endl;
+			if (tick.elapsed && scheduled % 100)
+				regular = false;
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(130));
+		std::cout << "(main) Notifying" << std::endl;
+		loop.notify();
+		std::this_thread::sleep_for(std::chrono::milliseconds(320));
+		loop.join();
+		if (!regular) {
+			std::cout << "(main) The notification moved the regular schedule" << std::endl;
+			return 1;
+		}
+	}
+	std::cout << "(main) Notified routine kept its schedule" << std::endl;
+	{
+		LoopingManualClock clock;
+		LoopingScheduler scheduler(clock);
+		int minutes = 0;
+		LoopingThread minutely(scheduler, std::chrono::minutes(1), [&minutes] {
+			minutes++;
+		});
+		LoopingThread hourly(scheduler, std::chrono::hours(1), [&minutes] {
+			std::cout << "(simulation) Hourly routine, the minutely one was called " << minutes << " times" << std::endl;
+		});
+		std::cout << "(main) Simulating 3 hours" << std::endl;
+		uint64_t calls = scheduler.runFor(std::chrono::hours(3));
+		std::cout << "(main) Simulated " << calls << " calls" << std::endl;
+	}
+	std::cout << "(main) Simulation ended successfully" << std::endl;
 	return 0;
 }
@@ -0,0 +1,79 @@
+/*
+* \brief Optional instrumentation of looping threads, reporting when they wait, wake up and call their routines
+*
+* The events are emitted only if LOOPING_THREAD_TRACING is defined before including the headers, otherwise the instrumentation points expand to
+* nothing. When enabled, they are passed to the sink set by setLoopingTraceSink(), which does nothing until a sink is set.
+*
+* \note The sink is called from the worker threads and from the threads controlling the loops, it must be thread-safe and fast
+*/
+
+#ifndef LOOPING_TRACE_H
+#define LOOPING_TRACE_H
+
+#include <atomic>
+
+/*!
+* \brief The kinds of events reported to the sink
+*/
+enum class LoopingTraceEvent {
+	WaitStart, //!< The worker starts waiting for the next call or for resumption
+	Wakeup, //!< The worker stopped waiting
+	RoutineBegin, //!< The routine is being called
+	RoutineEnd, //!< The routine has returned or thrown
+	Pause, //!< The loop was paused
+	Resume, //!< The loop was resumed
+	Error //!< The routine has thrown an exception
+};
+
+/*!
+* \brief Receiver of the events, implemented to forward them to a tracing framework
+*/
+class LoopingTraceSink {
+public:
+	inline virtual ~LoopingTraceSink()
+	{
+
+	}
+
+	/*!
+	* \brief Called for every event
+	* \param An identifier of the loop, the address of the object, doesn't change during its lifetime
+	* \param The name of the loop from its LoopingThreadOptions, empty if not set
+	* \param The event
+	*/
+	virtual void event(const void* loop, const char* name, LoopingTraceEvent event) = 0;
+};
+
+namespace LoopingDetail {
+
+	inline std::atomic<LoopingTraceSink*>& traceSink()
+	{
+		static std::atomic<LoopingTraceSink*> sink{nullptr};
+		return sink;
+	}
+
+	inline void trace(const void* loop, const char* name, LoopingTraceEvent event)
+	{
+		LoopingTraceSink* sink = traceSink().load(std::memory_order_acquire);
+		if (sink)
+			sink->event(loop, name, event);
+	}
+
+} // namespace LoopingDetail
+
+/*!
+* \brief Sets the sink receiving the events of all loops
+* \param The sink, must stay valid until it's replaced and all loops stop using it, null to stop tracing
+*/
+inline void setLoopingTraceSink(LoopingTraceSink* sink)
+{
+	LoopingDetail::traceSink().store(sink, std::memory_order_release);
+}
+
+#if defined(LOOPING_THREAD_TRACING)
+#define LOOPING_TRACE(loop, name, event) LoopingDetail::trace(loop, name, LoopingTraceEvent::event)
+#else
+#define LOOPING_TRACE(loop, name, event) ((void)0)
+#endif
+
+#endif // LOOPING_TRACE_H
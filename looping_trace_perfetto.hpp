@@ -0,0 +1,48 @@
+/*
+* \brief Trace sink forwarding the events of looping threads to Perfetto track events
+*
+* Every loop gets its own track, with slices for the routine calls and the waits between them and instant events for pausing, resuming and errors.
+* The application has to include this header where the Perfetto SDK is available and define the category, for example:
+*
+* PERFETTO_DEFINE_CATEGORIES(perfetto::Category("looping").SetDescription("Looping threads"));
+* PERFETTO_TRACK_EVENT_STATIC_STORAGE();
+*
+* \note Requires the Perfetto SDK, tracing must be initialised and LOOPING_THREAD_TRACING defined for any events to be emitted
+*/
+
+#ifndef LOOPING_TRACE_PERFETTO_H
+#define LOOPING_TRACE_PERFETTO_H
+
+#include <cstdint>
+#include <perfetto.h>
+#include "looping_trace.hpp"
+
+class LoopingPerfettoSink : public LoopingTraceSink {
+public:
+	inline void event(const void* loop, const char* name, LoopingTraceEvent event) override
+	{
+		perfetto::Track track(reinterpret_cast<uintptr_t>(loop));
+		switch (event) {
+		case LoopingTraceEvent::WaitStart:
+			TRACE_EVENT_BEGIN("looping", "wait", track);
+			break;
+		case LoopingTraceEvent::RoutineBegin:
+			TRACE_EVENT_BEGIN("looping", perfetto::DynamicString(*name ? name : "routine"), track);
+			break;
+		case LoopingTraceEvent::Wakeup:
+		case LoopingTraceEvent::RoutineEnd:
+			TRACE_EVENT_END("looping", track);
+			break;
+		case LoopingTraceEvent::Pause:
+			TRACE_EVENT_INSTANT("looping", "pause", track);
+			break;
+		case LoopingTraceEvent::Resume:
+			TRACE_EVENT_INSTANT("looping", "resume", track);
+			break;
+		case LoopingTraceEvent::Error:
+			TRACE_EVENT_INSTANT("looping", "error", track);
+			break;
+		}
+	}
+};
+#endif // LOOPING_TRACE_PERFETTO_H
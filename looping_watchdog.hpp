@@ -0,0 +1,144 @@
+/*
+* \brief Class for detecting routines of looping threads that hang or run for too long
+*
+* One monitor thread checks all loops registered with setWatchdog() in regular intervals. If a call of a routine has been running for longer than
+* the given multiple of its period, the loop's callback is called once for that call from the monitor thread, so that it can be logged or the
+* stack of the hanging thread dumped.
+*
+* \note The watchdog must outlive the loops registered in it
+*/
+
+#ifndef LOOPING_WATCHDOG_H
+#define LOOPING_WATCHDOG_H
+
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+/*!
+* \brief Description of a routine that is running for too long
+*/
+struct LoopingHang {
+	std::string name; //!< The name the loop was registered with
+	std::chrono::steady_clock::duration running; //!< How long the current call has been running
+	std::chrono::steady_clock::duration period; //!< The period of the loop
+	std::thread::native_handle_type thread; //!< The thread running the routine if the loop has its own, for example to signal it to dump its stack
+	bool ownThread; //!< If the thread is valid, it's not known if the routine is called by a LoopingScheduler
+};
+
+class LoopingWatchdog {
+	struct Entry {
+		const void* owner;
+		std::string name;
+		const std::atomic<std::chrono::steady_clock::rep>* callStarted;
+		const std::atomic<std::chrono::steady_clock::duration>* period;
+		double multiple;
+		std::function<void(const LoopingHang&)> callback;
+		std::thread::native_handle_type thread;
+		bool ownThread;
+		std::chrono::steady_clock::rep reported;
+	};
+
+	std::chrono::steady_clock::duration interval_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	bool exiting_ = false;
+	std::vector<Entry> entries_;
+	std::thread monitor_;
+
+	inline void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!exiting_) {
+			wakeup_.wait_for(lock, interval_);
+			if (exiting_)
+				break;
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			std::vector<std::pair<std::function<void(const LoopingHang&)>, LoopingHang>> hangs;
+			for (Entry& entry : entries_) {
+				std::chrono::steady_clock::rep started = entry.callStarted->load(std::memory_order_acquire);
+				if (started == 0 || started == entry.reported)
+					continue;
+				std::chrono::steady_clock::duration period = std::max(entry.period->load(std::memory_order_relaxed), interval_);
+				std::chrono::steady_clock::duration running = now - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(started));
+				if (running > std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * entry.multiple)) {
+					entry.reported = started;
+					hangs.push_back(std::make_pair(entry.callback, LoopingHang{entry.name, running, period, entry.thread, entry.ownThread}));
+				}
+			}
+			// The callbacks get only copies, so they can run without the lock while the loops are being destroyed
+			lock.unlock();
+			for (auto& hang : hangs) {
+				try {
+					hang.first(hang.second);
+				} catch(...) {
+				}
+			}
+			lock.lock();
+		}
+	}
+
+public:
+	/*!
+	* \brief Starts the monitor thread
+	* \param How often the loops are checked, hangs are detected at most this much later than they exceed the limit
+	*/
+	inline explicit LoopingWatchdog(std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100)) :
+		interval_(interval),
+		monitor_(&LoopingWatchdog::work, this)
+	{
+
+	}
+
+	LoopingWatchdog(const LoopingWatchdog&) = delete;
+	LoopingWatchdog& operator=(const LoopingWatchdog&) = delete;
+
+	/*!
+	* \brief The destructor, stops the monitor thread
+	*/
+	inline ~LoopingWatchdog()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			exiting_ = true;
+		}
+		wakeup_.notify_one();
+		monitor_.join();
+	}
+
+	/*!
+	* \brief Adds a loop, usually called by the loop itself
+	* \param The object identifying the loop when it's removed
+	* \param The name of the loop passed to the callback
+	* \param The time the current call started as steady_clock ticks, zero if the routine isn't running, must stay valid until removed
+	* \param The period of the loop, must stay valid until removed
+	* \param How many periods a call may take before it's reported, the period is at least the check interval
+	* \param The function called from the monitor thread when a call takes too long
+	* \param The thread calling the routine
+	* \param If the thread is valid
+	*/
+	inline void add(const void* owner, const std::string& name, const std::atomic<std::chrono::steady_clock::rep>& callStarted,
+			const std::atomic<std::chrono::steady_clock::duration>& period, double multiple, std::function<void(const LoopingHang&)> callback,
+			std::thread::native_handle_type thread, bool ownThread)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		entries_.push_back(Entry{owner, name, &callStarted, &period, multiple, callback, thread, ownThread, 0});
+	}
+
+	/*!
+	* \brief Removes a loop
+	* \param The object identifying the loop
+	*/
+	inline void remove(const void* owner)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [owner] (const Entry& entry) { return entry.owner == owner; }), entries_.end());
+	}
+};
+#endif // LOOPING_WATCHDOG_H